@@ -0,0 +1,116 @@
+/*
+    Astrometers protocol codecs
+
+    Author: Roman Dvořák <info@astrometers.cz>
+    Copyright (C) 2025 Astrometers
+*/
+
+#include "astrometers_proto.h"
+
+#include <charconv>
+#include <cstring>
+
+namespace Astrometers
+{
+namespace Proto
+{
+
+static std::string_view trim(std::string_view text)
+{
+    while (!text.empty() && (text.front() == ' ' || text.front() == '\t'))
+        text.remove_prefix(1);
+    while (!text.empty() && (text.back() == ' ' || text.back() == '\t' || text.back() == '\r'))
+        text.remove_suffix(1);
+    return text;
+}
+
+bool decodeHex(std::string_view text, uint32_t &value)
+{
+    if (text.empty())
+        return false;
+
+    const char *end = text.data() + text.size();
+    auto result = std::from_chars(text.data(), end, value, 16);
+    return result.ec == std::errc() && result.ptr == end;
+}
+
+size_t encodeHex(uint32_t value, int width, char *out, size_t outSize)
+{
+    static const char digits[] = "0123456789ABCDEF";
+
+    if (width <= 0 || static_cast<size_t>(width) > outSize)
+        return 0;
+
+    // Fill from the right, the value must fit into the requested width
+    for (int i = width - 1; i >= 0; i--)
+    {
+        out[i] = digits[value & 0xF];
+        value >>= 4;
+    }
+
+    return value == 0 ? static_cast<size_t>(width) : 0;
+}
+
+size_t encodeCommand(std::string_view cmd, uint32_t param, int width, char *out, size_t outSize)
+{
+    // ':' + command + hex + '#' + NUL
+    size_t length = 1 + cmd.size() + static_cast<size_t>(width) + 1;
+    if (width <= 0 || length + 1 > outSize)
+        return 0;
+
+    out[0] = ':';
+    memcpy(out + 1, cmd.data(), cmd.size());
+    if (encodeHex(param, width, out + 1 + cmd.size(), static_cast<size_t>(width)) == 0)
+        return 0;
+
+    out[length - 1] = '#';
+    out[length] = '\0';
+    return length;
+}
+
+size_t splitFields(std::string_view line, std::string_view fields[], size_t maxFields, char separator)
+{
+    size_t count = 0;
+    size_t start = 0;
+
+    while (true)
+    {
+        size_t end = line.find(separator, start);
+        if (count < maxFields)
+            fields[count] = line.substr(start, end == std::string_view::npos ? std::string_view::npos : end - start);
+        count++;
+
+        if (end == std::string_view::npos)
+            return count;
+        start = end + 1;
+    }
+}
+
+bool decodeDouble(std::string_view text, double &value)
+{
+    text = trim(text);
+    if (!text.empty() && text.front() == '+')
+        text.remove_prefix(1);
+    if (text.empty())
+        return false;
+
+    const char *end = text.data() + text.size();
+    auto result = std::from_chars(text.data(), end, value);
+    return result.ec == std::errc() && result.ptr == end;
+}
+
+bool decodeInt(std::string_view text, int &value)
+{
+    text = trim(text);
+    if (!text.empty() && text.front() == '+')
+        text.remove_prefix(1);
+    if (text.empty())
+        return false;
+
+    const char *end = text.data() + text.size();
+    auto result = std::from_chars(text.data(), end, value);
+    return result.ec == std::errc() && result.ptr == end;
+}
+
+}
+}
@@ -0,0 +1,47 @@
+/*
+    Astrometers protocol codecs
+
+    Allocation-free encoders and decoders shared by the Astrometers drivers.
+    Everything works on caller-provided buffers and std::string_view, nothing
+    throws and nothing touches the heap.
+
+    Author: Roman Dvořák <info@astrometers.cz>
+    Copyright (C) 2025 Astrometers
+*/
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+namespace Astrometers
+{
+namespace Proto
+{
+
+// AMFOC01 frames: ":<CMD><hex param>#" commands and "<hex>#" replies
+
+// Parse an unsigned hexadecimal number, the whole text must be consumed
+bool decodeHex(std::string_view text, uint32_t &value);
+
+// Write value as zero-padded uppercase hex of the given width, no terminator.
+// Returns the number of characters written, 0 if it does not fit.
+size_t encodeHex(uint32_t value, int width, char *out, size_t outSize);
+
+// Build ":<cmd><hex param>#" into out, NUL terminated.
+// Returns the frame length without the terminator, 0 if it does not fit.
+size_t encodeCommand(std::string_view cmd, uint32_t param, int width, char *out, size_t outSize);
+
+// AMSKY01 sentences: "$<type>,<field>,<field>,..."
+
+// Split line at separators into views of the original text.
+// Returns the number of fields found; fields beyond maxFields are not stored.
+size_t splitFields(std::string_view line, std::string_view fields[], size_t maxFields, char separator = ',');
+
+// Parse a decimal number, surrounding blanks allowed, the rest must be consumed
+bool decodeDouble(std::string_view text, double &value);
+bool decodeInt(std::string_view text, int &value);
+
+}
+}
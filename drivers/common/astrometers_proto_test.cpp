@@ -0,0 +1,252 @@
+/*
+    Astrometers protocol codecs: tests and throughput
+
+    Round-trips the codecs on valid and invalid input, then times a mixed
+    AMFOC01/AMSKY01 workload. operator new is replaced to check that the
+    codecs keep their promise of never touching the heap. Needs no libindi.
+
+    Author: Roman Dvořák <info@astrometers.cz>
+    Copyright (C) 2025 Astrometers
+*/
+
+#include "astrometers_proto.h"
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <string_view>
+
+using namespace Astrometers::Proto;
+
+static size_t allocations = 0;
+
+void *operator new(size_t size)
+{
+    allocations++;
+    if (void *p = malloc(size ? size : 1))
+        return p;
+    throw std::bad_alloc();
+}
+
+void *operator new[](size_t size)
+{
+    return operator new(size);
+}
+
+void operator delete(void *p) noexcept
+{
+    free(p);
+}
+
+void operator delete[](void *p) noexcept
+{
+    free(p);
+}
+
+void operator delete(void *p, size_t) noexcept
+{
+    free(p);
+}
+
+void operator delete[](void *p, size_t) noexcept
+{
+    free(p);
+}
+
+static int failures = 0;
+
+#define CHECK(condition) \
+    do \
+    { \
+        if (!(condition)) \
+        { \
+            fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #condition); \
+            failures++; \
+        } \
+    } while (0)
+
+static void testHex()
+{
+    char out[16];
+    uint32_t value = 0;
+
+    // Round trip at every width that fits
+    const uint32_t values[] = { 0, 1, 0xF, 0x1A2B, 0xC350, 0xFFFF, 0x12345678, 0xFFFFFFFF };
+    for (uint32_t v : values)
+    {
+        for (int width = 1; width <= 8; width++)
+        {
+            size_t n = encodeHex(v, width, out, sizeof(out));
+            bool fits = width == 8 || (v >> (4 * width)) == 0;
+            CHECK(n == (fits ? static_cast<size_t>(width) : 0));
+            if (n > 0)
+            {
+                CHECK(decodeHex(std::string_view(out, n), value));
+                CHECK(value == v);
+            }
+        }
+    }
+
+    CHECK(encodeHex(0x1A2B, 6, out, sizeof(out)) == 6 && std::string_view(out, 6) == "001A2B");
+    CHECK(decodeHex("c350", value) && value == 0xC350);
+
+    // Bad widths and buffers
+    CHECK(encodeHex(1, 0, out, sizeof(out)) == 0);
+    CHECK(encodeHex(1, -1, out, sizeof(out)) == 0);
+    CHECK(encodeHex(1, 4, out, 3) == 0);
+
+    // The whole text must be a hex number that fits 32 bits
+    const char *invalid[] = { "", "G1", "12 ", " 12", "-1", "+1", "0x10", "12#", "100000000" };
+    for (const char *text : invalid)
+    {
+        if (decodeHex(text, value))
+        {
+            fprintf(stderr, "decodeHex accepted \"%s\"\n", text);
+            failures++;
+        }
+    }
+}
+
+static void testCommand()
+{
+    char out[16];
+    uint32_t value = 0;
+
+    CHECK(encodeCommand("SN", 0x1234, 4, out, sizeof(out)) == 8);
+    CHECK(strcmp(out, ":SN1234#") == 0);
+    CHECK(decodeHex(std::string_view(out + 3, 4), value) && value == 0x1234);
+
+    CHECK(encodeCommand("GP", 0, 0, out, sizeof(out)) == 0);
+    CHECK(encodeCommand("SN", 0x12345, 4, out, sizeof(out)) == 0);
+
+    // Frame plus NUL must fit exactly
+    CHECK(encodeCommand("SN", 0x1234, 4, out, 9) == 8);
+    CHECK(encodeCommand("SN", 0x1234, 4, out, 8) == 0);
+}
+
+static void testFields()
+{
+    std::string_view fields[4];
+
+    CHECK(splitFields("$cloud,-12.5,,3", fields, 4) == 4);
+    CHECK(fields[0] == "$cloud" && fields[1] == "-12.5" && fields[2].empty() && fields[3] == "3");
+
+    // Fields beyond maxFields are counted, not stored
+    fields[2] = "untouched";
+    CHECK(splitFields("a,b,c,d,e,f", fields, 2) == 6);
+    CHECK(fields[0] == "a" && fields[1] == "b" && fields[2] == "untouched");
+
+    CHECK(splitFields("", fields, 4) == 1 && fields[0].empty());
+    CHECK(splitFields("a,", fields, 4) == 2 && fields[0] == "a" && fields[1].empty());
+    CHECK(splitFields("a;b", fields, 4, ';') == 2 && fields[1] == "b");
+}
+
+static void testNumbers()
+{
+    double d = 0;
+    int i = 0;
+    char text[32];
+
+    CHECK(decodeDouble(" 12.5 ", d) && d == 12.5);
+    CHECK(decodeDouble("+3", d) && d == 3);
+    CHECK(decodeDouble("-0.25\r", d) && d == -0.25);
+    CHECK(decodeDouble("1e3", d) && d == 1000);
+
+    // Shortest round trip form of a few awkward values
+    const double doubles[] = { 0.1, -273.15, 1e-9, 6.02214076e23, 21.473 };
+    for (double v : doubles)
+    {
+        snprintf(text, sizeof(text), "%.17g", v);
+        CHECK(decodeDouble(text, d) && d == v);
+    }
+
+    const char *badDoubles[] = { "", " ", "+", "abc", "1.2.3", "12x", "1,5", "--1" };
+    for (const char *bad : badDoubles)
+    {
+        if (decodeDouble(bad, d))
+        {
+            fprintf(stderr, "decodeDouble accepted \"%s\"\n", bad);
+            failures++;
+        }
+    }
+
+    CHECK(decodeInt("42", i) && i == 42);
+    CHECK(decodeInt(" -7 ", i) && i == -7);
+    CHECK(decodeInt("+3", i) && i == 3);
+    CHECK(decodeInt("2147483647", i) && i == 2147483647);
+
+    const char *badInts[] = { "", "+", "4.2", "0x1", "99999999999", "1 2", "-" };
+    for (const char *bad : badInts)
+    {
+        if (decodeInt(bad, i))
+        {
+            fprintf(stderr, "decodeInt accepted \"%s\"\n", bad);
+            failures++;
+        }
+    }
+}
+
+// One AMFOC01 command and reply, one AMSKY01 sentence: a message each
+static void benchmark(size_t rounds)
+{
+    static const std::string_view replies[] = { "0000C350", "00001A2B", "0000FFFF" };
+    static const std::string_view sentences[] =
+    {
+        "$cloud,-12.34,-13.05,-12.80,-11.96,-14.21",
+        "$hygro,21.50,45.2",
+        "$light,0.0123,812,77,2,300",
+    };
+
+    char frame[16];
+    std::string_view fields[8];
+    uint32_t position;
+    double value;
+    double sum = 0;
+
+    size_t before = allocations;
+    auto start = std::chrono::steady_clock::now();
+
+    for (size_t n = 0; n < rounds; n++)
+    {
+        encodeCommand("SN", static_cast<uint32_t>(n & 0xFFFF), 4, frame, sizeof(frame));
+        if (decodeHex(replies[n % 3], position))
+            sum += position;
+
+        size_t count = splitFields(sentences[n % 3], fields, 8);
+        for (size_t f = 1; f < count && f < 8; f++)
+            if (decodeDouble(fields[f], value))
+                sum += value;
+    }
+
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    size_t used = allocations - before;
+
+    // Two messages per round, sum keeps the loop from being optimized away
+    printf("%zu messages in %.3f s: %.0f msgs/s, %zu allocations (checksum %.0f)\n", 2 * rounds, seconds,
+           seconds > 0 ? 2 * rounds / seconds : 0, used, std::fmod(sum, 1e6));
+    CHECK(used == 0);
+}
+
+int main(int argc, char *argv[])
+{
+    size_t before = allocations;
+    testHex();
+    testCommand();
+    testFields();
+    testNumbers();
+    CHECK(allocations == before);
+
+    size_t rounds = argc > 1 ? strtoul(argv[1], nullptr, 10) : 1000000;
+    benchmark(rounds);
+
+    if (failures > 0)
+    {
+        fprintf(stderr, "%d checks failed\n", failures);
+        return 1;
+    }
+    printf("All checks passed\n");
+    return 0;
+}
@@ -0,0 +1,237 @@
+/*
+    Asynchronous console log for Astrometers drivers
+
+    Author: Roman Dvořák <info@astrometers.cz>
+    Copyright (C) 2025 Astrometers
+*/
+
+#include "asynclog.h"
+
+#include <chrono>
+#include <cstdarg>
+#include <cstdio>
+#include <cstring>
+
+namespace Astrometers
+{
+
+// How long the writer sleeps when the ring is empty
+static constexpr std::chrono::milliseconds IDLE_SLEEP(50);
+
+static const char *LEVEL_NAMES[] = { "", "ERROR", "WARN", "INFO", "DEBUG" };
+
+AsyncLog::AsyncLog(const char *prefix) : prefix(prefix)
+{
+    for (size_t i = 0; i < CAPACITY; i++)
+        slots[i].sequence.store(i, std::memory_order_relaxed);
+}
+
+AsyncLog::~AsyncLog()
+{
+    stop();
+}
+
+void AsyncLog::start()
+{
+    if (writer.joinable())
+        return;
+
+    running = true;
+    writer = std::thread(&AsyncLog::writerLoop, this);
+}
+
+void AsyncLog::stop()
+{
+    running = false;
+    if (writer.joinable())
+        writer.join();
+}
+
+int AsyncLog::addCategory(const char *name, LogLevel level)
+{
+    if (categoryCount >= MAX_CATEGORIES)
+        return -1;
+
+    categoryNames[categoryCount] = name;
+    levels[categoryCount].store(level, std::memory_order_relaxed);
+    return categoryCount++;
+}
+
+const char *AsyncLog::categoryName(int category) const
+{
+    if (category < 0 || category >= categoryCount)
+        return "";
+    return categoryNames[category];
+}
+
+void AsyncLog::setLevel(int category, LogLevel level)
+{
+    if (category >= 0 && category < categoryCount)
+        levels[category].store(level, std::memory_order_relaxed);
+}
+
+LogLevel AsyncLog::level(int category) const
+{
+    if (category < 0 || category >= categoryCount)
+        return LogLevel::Off;
+    return levels[category].load(std::memory_order_relaxed);
+}
+
+void AsyncLog::setDebug(bool enable)
+{
+    debugAll.store(enable, std::memory_order_relaxed);
+}
+
+void AsyncLog::log(int category, LogLevel level, const char *format, ...)
+{
+    if (!enabled(category, level))
+        return;
+
+    // Claim a slot, bounded multi-producer ring after D. Vyukov
+    size_t pos = enqueuePos.load(std::memory_order_relaxed);
+    Slot *slot;
+    for (;;)
+    {
+        slot = &slots[pos & (CAPACITY - 1)];
+        size_t sequence = slot->sequence.load(std::memory_order_acquire);
+        intptr_t diff = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(pos);
+
+        if (diff == 0)
+        {
+            if (enqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                break;
+        }
+        else if (diff < 0)
+        {
+            // Ring is full, the writer cannot keep up
+            droppedMessages.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        else
+        {
+            pos = enqueuePos.load(std::memory_order_relaxed);
+        }
+    }
+
+    struct timespec now;
+    clock_gettime(CLOCK_REALTIME_COARSE, &now);
+
+    slot->category = static_cast<uint8_t>(category);
+    slot->level = level;
+    slot->seconds = now.tv_sec;
+    slot->millis = static_cast<uint16_t>(now.tv_nsec / 1000000);
+
+    va_list args;
+    va_start(args, format);
+    int length = vsnprintf(slot->text, MESSAGE_SIZE, format, args);
+    va_end(args);
+
+    if (length < 0)
+        length = 0;
+        
+    // A cut message says so instead of ending mid-word
+    if (length >= static_cast<int>(MESSAGE_SIZE))
+    {
+        length = MESSAGE_SIZE - 1;
+        memcpy(slot->text + length - 3, "...", 3);
+    }
+    slot->length = static_cast<uint16_t>(length);
+
+    slot->sequence.store(pos + 1, std::memory_order_release);
+}
+
+void AsyncLog::writerLoop()
+{
+    while (running)
+    {
+        bool wrote = false;
+        while (drainOne())
+            wrote = true;
+
+        // One flush per batch instead of one per line
+        if (wrote)
+            fflush(stderr);
+        else
+            std::this_thread::sleep_for(IDLE_SLEEP);
+    }
+
+    // Whatever was queued before stop() still gets out
+    while (drainOne())
+        ;
+    for (auto &state : rateStates)
+        flushSuppressed(state);
+    fflush(stderr);
+}
+
+bool AsyncLog::drainOne()
+{
+    Slot &slot = slots[dequeuePos & (CAPACITY - 1)];
+    if (slot.sequence.load(std::memory_order_acquire) != dequeuePos + 1)
+        return false;
+
+    if (!rateLimited(slot))
+    {
+        fprintf(stderr, "%s [%s.%03u] %s %s: %.*s\n", prefix, formatTime(slot.seconds), slot.millis,
+                categoryNames[slot.category], LEVEL_NAMES[static_cast<int>(slot.level)], slot.length, slot.text);
+    }
+
+    slot.sequence.store(dequeuePos + CAPACITY, std::memory_order_release);
+    dequeuePos++;
+    return true;
+}
+
+bool AsyncLog::rateLimited(const Slot &slot)
+{
+    // Messages are told apart by their text, FNV-1a with the category mixed in.
+    // A call site logging "%s" produces different messages, not repeats.
+    uint64_t hash = 14695981039346656037ull ^ slot.category;
+    for (uint16_t i = 0; i < slot.length; i++)
+        hash = (hash ^ static_cast<uint8_t>(slot.text[i])) * 1099511628211ull;
+    RateState &state = rateStates[hash % RATE_SLOTS];
+
+    if (state.hash != hash)
+    {
+        flushSuppressed(state);
+        state.hash = hash;
+        state.category = slot.category;
+        state.window = slot.seconds;
+        state.count = 0;
+    }
+    else if (state.window != slot.seconds)
+    {
+        flushSuppressed(state);
+        state.window = slot.seconds;
+        state.count = 0;
+    }
+
+    if (++state.count <= RATE_LIMIT)
+        return false;
+
+    state.suppressed++;
+    return true;
+}
+
+void AsyncLog::flushSuppressed(RateState &state)
+{
+    if (state.suppressed == 0)
+        return;
+
+    fprintf(stderr, "%s [%s] %s: %d repeated messages suppressed\n", prefix, formatTime(state.window),
+            categoryNames[state.category], state.suppressed);
+    state.suppressed = 0;
+}
+
+const char *AsyncLog::formatTime(time_t seconds)
+{
+    // Timestamps only change once a second, so format them once a second
+    if (seconds != cachedSecond)
+    {
+        struct tm local;
+        localtime_r(&seconds, &local);
+        strftime(cachedStamp, sizeof(cachedStamp), "%H:%M:%S", &local);
+        cachedSecond = seconds;
+    }
+    return cachedStamp;
+}
+
+}
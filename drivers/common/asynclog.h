@@ -0,0 +1,128 @@
+/*
+    Asynchronous console log for Astrometers drivers
+
+    Messages are formatted into a lock-free ring by the caller and written to
+    stderr by a background thread, so logging never blocks a data path on
+    console or SD card I/O.
+
+    Author: Roman Dvořák <info@astrometers.cz>
+    Copyright (C) 2025 Astrometers
+*/
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <ctime>
+#include <thread>
+
+namespace Astrometers
+{
+
+enum class LogLevel : uint8_t
+{
+    Off,
+    Error,
+    Warning,
+    Info,
+    Debug
+};
+
+class AsyncLog
+{
+public:
+    static constexpr int MAX_CATEGORIES = 8;
+    static constexpr size_t MESSAGE_SIZE = 240;     // longer messages are cut and end in "..."
+
+    // prefix is printed in front of every line, e.g. "[AMSKY01]"
+    explicit AsyncLog(const char *prefix);
+    ~AsyncLog();
+
+    AsyncLog(const AsyncLog &) = delete;
+    AsyncLog &operator=(const AsyncLog &) = delete;
+
+    void start();
+    void stop();
+
+    // Categories are registered once at startup, returns the category id or -1
+    int addCategory(const char *name, LogLevel level);
+    const char *categoryName(int category) const;
+    void setLevel(int category, LogLevel level);
+    LogLevel level(int category) const;
+
+    // INDI debug switch: while enabled every category logs everything
+    void setDebug(bool enable);
+
+    bool enabled(int category, LogLevel level) const
+    {
+        if (category < 0 || category >= categoryCount)
+            return false;
+        if (debugAll.load(std::memory_order_relaxed))
+            return true;
+        return level <= levels[category].load(std::memory_order_relaxed);
+    }
+
+    // Safe from any thread. Repeats of the same text in a category are limited
+    // to RATE_LIMIT lines per second, the rest is counted and summarized.
+    // Distinct messages are never held back.
+    void log(int category, LogLevel level, const char *format, ...) __attribute__((format(printf, 4, 5)));
+
+    uint64_t dropped() const
+    {
+        return droppedMessages.load(std::memory_order_relaxed);
+    }
+
+private:
+    static constexpr size_t CAPACITY = 512;
+    static constexpr int RATE_LIMIT = 10;
+    static constexpr int RATE_SLOTS = 64;
+
+    struct Slot
+    {
+        std::atomic<size_t> sequence;
+        uint8_t category;
+        LogLevel level;
+        time_t seconds;
+        uint16_t millis;
+        uint16_t length;
+        char text[MESSAGE_SIZE];
+    };
+
+    // Per message text counters, only touched by the writer thread
+    struct RateState
+    {
+        uint64_t hash = 0;
+        uint8_t category = 0;
+        time_t window = 0;
+        int count = 0;
+        int suppressed = 0;
+    };
+
+    void writerLoop();
+    bool drainOne();
+    bool rateLimited(const Slot &slot);
+    void flushSuppressed(RateState &state);
+    const char *formatTime(time_t seconds);
+
+    const char *prefix;
+    const char *categoryNames[MAX_CATEGORIES] {};
+    std::atomic<LogLevel> levels[MAX_CATEGORIES] {};
+    int categoryCount = 0;
+    std::atomic<bool> debugAll{false};
+
+    Slot slots[CAPACITY];
+    alignas(64) std::atomic<size_t> enqueuePos{0};
+    alignas(64) size_t dequeuePos = 0;
+    std::atomic<uint64_t> droppedMessages{0};
+
+    std::thread writer;
+    std::atomic<bool> running{false};
+
+    // Writer thread state
+    RateState rateStates[RATE_SLOTS];
+    time_t cachedSecond = 0;
+    char cachedStamp[16] {};
+};
+
+}
@@ -0,0 +1,92 @@
+/*
+    Fixed-bucket latency histogram
+
+    Author: Roman Dvořák <info@astrometers.cz>
+    Copyright (C) 2025 Astrometers
+*/
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+// Lock-free histogram with half-octave buckets from 64 us to about 3 s,
+// the last bucket also collects anything slower.
+// One thread records while another may read or reset; counts are relaxed
+// atomics, which is good enough for diagnostics.
+class LatencyHistogram
+{
+public:
+    static constexpr int BUCKETS = 32;
+
+    void record(uint32_t micros)
+    {
+        buckets[bucketIndex(micros)].fetch_add(1, std::memory_order_relaxed);
+    }
+
+    void reset()
+    {
+        for (auto &bucket : buckets)
+            bucket.store(0, std::memory_order_relaxed);
+    }
+
+    uint64_t count() const
+    {
+        uint64_t total = 0;
+        for (const auto &bucket : buckets)
+            total += bucket.load(std::memory_order_relaxed);
+        return total;
+    }
+
+    uint64_t bucketCount(int bucket) const
+    {
+        return buckets[bucket].load(std::memory_order_relaxed);
+    }
+
+    // Upper bound of the bucket holding the given percentile (0-100), in microseconds
+    uint32_t percentile(double p) const
+    {
+        uint64_t total = count();
+        if (total == 0)
+            return 0;
+
+        uint64_t rank = static_cast<uint64_t>(p / 100.0 * total + 0.5);
+        if (rank < 1)
+            rank = 1;
+
+        uint64_t seen = 0;
+        for (int i = 0; i < BUCKETS; i++)
+        {
+            seen += buckets[i].load(std::memory_order_relaxed);
+            if (seen >= rank)
+                return bucketUpperBound(i);
+        }
+        return bucketUpperBound(BUCKETS - 1);
+    }
+
+    // Bucket 0 holds everything below 64 us, then each octave is split in two halves
+    static uint32_t bucketUpperBound(int bucket)
+    {
+        if (bucket == 0)
+            return 64;
+
+        uint32_t base = 64u << ((bucket - 1) / 2);
+        return ((bucket - 1) % 2 == 0) ? base + base / 2 : 2 * base;
+    }
+
+private:
+    static int bucketIndex(uint32_t micros)
+    {
+        uint32_t scaled = micros >> 6;
+        if (scaled == 0)
+            return 0;
+
+        int octave = 31 - __builtin_clz(scaled);
+        uint32_t base = 64u << octave;
+        int half = (micros >= base + base / 2) ? 1 : 0;
+        int index = 1 + 2 * octave + half;
+        return index < BUCKETS ? index : BUCKETS - 1;
+    }
+
+    std::atomic<uint32_t> buckets[BUCKETS] {};
+};
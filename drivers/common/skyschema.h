@@ -0,0 +1,346 @@
+/*
+    AMSKY01 sentence schema
+
+    Every sentence the sensor sends is declared once below: its fields, the
+    weather parameters derived from it with their units, ranges and publish
+    filter defaults, and the function computing them. Parsing, property
+    registration and publication in the driver are generated from this table,
+    so a new firmware sentence is a single entry in SENTENCES. AMTEST01's
+    protocol decoder checks sniffed sentences against the same table.
+
+    Author: Roman Dvořák <info@astrometers.cz>
+    Copyright (C) 2025 Astrometers
+*/
+
+#pragma once
+
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <string_view>
+#include <utility>
+
+#include "astrometers_proto.h"
+
+namespace SkySchema
+{
+
+static constexpr size_t MAX_FIELDS = 8;
+static constexpr size_t MAX_PARAMETERS = 8;
+
+enum class FieldType : uint8_t
+{
+    Real,
+    Integer     // must parse as an integer, stored as double
+};
+
+struct Field
+{
+    const char *name;
+    FieldType type;
+};
+
+// One weather parameter as registered with INDI::Weather
+struct Parameter
+{
+    const char *name;
+    const char *label;
+    const char *unit;
+    double minOk;
+    double maxOk;
+    double deadband;    // publish filter default, unit of the parameter
+    double interval;    // publish filter default, ms
+};
+
+struct Sentence
+{
+    std::string_view tag;                           // "$<tag>,field,..."
+    Field fields[MAX_FIELDS];
+    size_t fieldCount;
+    bool (*valid)(const double *fields);            // plausibility beyond parsing, may be nullptr
+    Parameter parameters[MAX_PARAMETERS];
+    size_t parameterCount;
+    void (*derive)(const double *fields, double *parameters);
+};
+
+// Magnus formula
+inline double dewPoint(double temperature, double humidity)
+{
+    const double a = 17.27;
+    const double b = 237.7;
+    double alpha = ((a * temperature) / (b + temperature)) + std::log(humidity / 100.0);
+    return (b * alpha) / (a - alpha);
+}
+
+inline double skyBrightness(double lux)
+{
+    // Velmi tmavá obloha: ~22 mag/arcsec² při <0.01 lux
+    // Jasná obloha při úplňku: ~19 mag/arcsec² při ~0.1 lux
+    // Městské světlo: ~16-18 mag/arcsec² při >10 lux
+    double brightness = (lux < 0.001) ? 22.0 : 22.0 - 2.5 * std::log10(lux * 100);
+
+    // Omez na rozumné hodnoty
+    if (brightness < 15.0) brightness = 15.0;
+    if (brightness > 22.5) brightness = 22.5;
+    return brightness;
+}
+
+inline double cloudCover(double averageSkyTemp)
+{
+    const double minSkyTemp = 64000.0;  // jasná studená obloha
+    const double maxSkyTemp = 66000.0;  // velmi oblačno
+
+    double cover = ((averageSkyTemp - minSkyTemp) / (maxSkyTemp - minSkyTemp)) * 100.0;
+    if (cover < 0.0) cover = 0.0;
+    if (cover > 100.0) cover = 100.0;
+    return cover;
+}
+
+// Parameters are registered, published and recorded in the order they appear here
+inline constexpr Sentence SENTENCES[] =
+{
+    {
+        // $hygro,temperature,humidity
+        "hygro",
+        { { "temperature", FieldType::Real }, { "humidity", FieldType::Real } }, 2,
+        nullptr,
+        {
+            { "WEATHER_TEMPERATURE", "Temperature", "°C", -50, 80, 0.1, 1000 },
+            { "WEATHER_HUMIDITY", "Humidity", "%", 0, 100, 0.5, 1000 },
+            { "WEATHER_DEW_POINT", "Dew Point", "°C", -50, 50, 0.1, 1000 },
+        }, 3,
+        [](const double *f, double *p)
+        {
+            p[0] = f[0];
+            p[1] = f[1];
+            p[2] = dewPoint(f[0], f[1]);
+        }
+    },
+    {
+        // $light,lux,raw1,raw2,gain,integration_time_ms
+        "light",
+        {
+            { "lux", FieldType::Real }, { "raw1", FieldType::Integer }, { "raw2", FieldType::Integer },
+            { "gain", FieldType::Integer }, { "integration_time", FieldType::Integer }
+        }, 5,
+        [](const double *f)
+        {
+            return f[3] > 0 && f[4] > 0;
+        },
+        {
+            { "WEATHER_LIGHT_LUX", "Light", "lux", 0, 100000, 0.01, 1000 },
+            { "WEATHER_SKY_BRIGHTNESS", "Sky Brightness", "mag/arcsec²", 10, 25, 0.05, 1000 },
+        }, 2,
+        [](const double *f, double *p)
+        {
+            // Lux is derived from raw1 / gain / integration time, the lux field is not used
+            p[0] = f[1] / f[3] / f[4] * 1000000.0;
+            p[1] = skyBrightness(p[0]);
+        }
+    },
+    {
+        // $cloud,temp1,temp2,temp3,temp4,temp5 (4 segmenty + zenit)
+        "cloud",
+        {
+            { "temp1", FieldType::Real }, { "temp2", FieldType::Real }, { "temp3", FieldType::Real },
+            { "temp4", FieldType::Real }, { "temp5", FieldType::Real }
+        }, 5,
+        nullptr,
+        {
+            { "WEATHER_CLOUD_COVER", "Cloud Cover", "%", 0, 100, 1.0, 1000 },
+            { "WEATHER_SKY_TEMPERATURE", "Sky Temperature Avg", "°C", -80, 50, 1.0, 1000 },
+            { "WEATHER_SKY_TEMP_1", "Sky Temp 1", "°C", -80, 50, 1.0, 5000 },
+            { "WEATHER_SKY_TEMP_2", "Sky Temp 2", "°C", -80, 50, 1.0, 5000 },
+            { "WEATHER_SKY_TEMP_3", "Sky Temp 3", "°C", -80, 50, 1.0, 5000 },
+            { "WEATHER_SKY_TEMP_4", "Sky Temp 4", "°C", -80, 50, 1.0, 5000 },
+            { "WEATHER_SKY_TEMP_5", "Sky Temp 5 - Zenith", "°C", -80, 50, 1.0, 5000 },
+        }, 7,
+        [](const double *f, double *p)
+        {
+            double average = (f[0] + f[1] + f[2] + f[3] + f[4]) / 5.0;
+            p[0] = cloudCover(average);
+            p[1] = average;
+            for (int i = 0; i < 5; i++)
+                p[2 + i] = f[i];
+        }
+    },
+};
+
+static constexpr size_t SENTENCE_COUNT = sizeof(SENTENCES) / sizeof(SENTENCES[0]);
+
+// Everything below is derived from SENTENCES at compile time
+
+constexpr bool equal(const char *a, std::string_view b)
+{
+    size_t i = 0;
+    for (; a[i] != '\0'; i++)
+    {
+        if (i >= b.size() || a[i] != b[i])
+            return false;
+    }
+    return i == b.size();
+}
+
+constexpr size_t countParameters()
+{
+    size_t count = 0;
+    for (const auto &sentence : SENTENCES)
+        count += sentence.parameterCount;
+    return count;
+}
+
+static constexpr size_t PARAMETER_COUNT = countParameters();
+
+// Index of each sentence's first parameter in the flat parameter list
+constexpr std::array<size_t, SENTENCE_COUNT> parameterOffsets()
+{
+    std::array<size_t, SENTENCE_COUNT> offsets {};
+    size_t offset = 0;
+    for (size_t i = 0; i < SENTENCE_COUNT; i++)
+    {
+        offsets[i] = offset;
+        offset += SENTENCES[i].parameterCount;
+    }
+    return offsets;
+}
+
+static constexpr std::array<size_t, SENTENCE_COUNT> PARAMETER_OFFSETS = parameterOffsets();
+
+constexpr std::array<Parameter, PARAMETER_COUNT> flattenParameters()
+{
+    std::array<Parameter, PARAMETER_COUNT> parameters {};
+    size_t next = 0;
+    for (const auto &sentence : SENTENCES)
+    {
+        for (size_t i = 0; i < sentence.parameterCount; i++)
+            parameters[next++] = sentence.parameters[i];
+    }
+    return parameters;
+}
+
+static constexpr std::array<Parameter, PARAMETER_COUNT> PARAMETERS = flattenParameters();
+
+// Lookups by name, a typo is a compile error when used in a constant expression
+constexpr int sentenceIndex(std::string_view tag)
+{
+    for (size_t i = 0; i < SENTENCE_COUNT; i++)
+    {
+        if (SENTENCES[i].tag == tag)
+            return static_cast<int>(i);
+    }
+    throw std::logic_error("unknown sentence");
+}
+
+constexpr int parameterIndex(std::string_view name)
+{
+    for (size_t i = 0; i < PARAMETER_COUNT; i++)
+    {
+        if (equal(PARAMETERS[i].name, name))
+            return static_cast<int>(i);
+    }
+    throw std::logic_error("unknown parameter");
+}
+
+constexpr int fieldIndex(std::string_view tag, std::string_view name)
+{
+    const Sentence &sentence = SENTENCES[sentenceIndex(tag)];
+    for (size_t i = 0; i < sentence.fieldCount; i++)
+    {
+        if (equal(sentence.fields[i].name, name))
+            return static_cast<int>(i);
+    }
+    throw std::logic_error("unknown field");
+}
+
+// Dispatch key of a tag: its first and last character. Collisions are
+// rejected at compile time, a longer key is only needed if that ever fires.
+static constexpr size_t DISPATCH_SIZE = 64;
+
+constexpr size_t dispatchKey(std::string_view tag)
+{
+    return (static_cast<unsigned char>(tag.front()) * 7u + static_cast<unsigned char>(tag.back())) % DISPATCH_SIZE;
+}
+
+constexpr std::array<int8_t, DISPATCH_SIZE> buildDispatch()
+{
+    std::array<int8_t, DISPATCH_SIZE> table {};
+    for (auto &entry : table)
+        entry = -1;
+    for (size_t i = 0; i < SENTENCE_COUNT; i++)
+    {
+        size_t key = dispatchKey(SENTENCES[i].tag);
+        if (table[key] != -1)
+            throw std::logic_error("sentence dispatch keys collide");
+        table[key] = static_cast<int8_t>(i);
+    }
+    return table;
+}
+
+static constexpr std::array<int8_t, DISPATCH_SIZE> DISPATCH = buildDispatch();
+
+// Sentence index of a tag, -1 if unknown: one table lookup and one compare
+inline int findSentence(std::string_view tag)
+{
+    if (tag.empty())
+        return -1;
+    int index = DISPATCH[dispatchKey(tag)];
+    return (index >= 0 && SENTENCES[index].tag == tag) ? index : -1;
+}
+
+// Parser specialized for one sentence: the field count and types are constants,
+// so the decode loop unrolls into straight calls. fields[0] is the tag.
+template <size_t S>
+bool parse(const std::string_view *fields, size_t count, double *values, double *parameters)
+{
+    constexpr const Sentence &sentence = SENTENCES[S];
+
+    if (count < sentence.fieldCount + 1)
+        return false;
+
+    for (size_t i = 0; i < sentence.fieldCount; i++)
+    {
+        if (sentence.fields[i].type == FieldType::Integer)
+        {
+            int value = 0;
+            if (!Astrometers::Proto::decodeInt(fields[i + 1], value))
+                return false;
+            values[i] = value;
+        }
+        else if (!Astrometers::Proto::decodeDouble(fields[i + 1], values[i]))
+        {
+            return false;
+        }
+    }
+
+    if (sentence.valid != nullptr && !sentence.valid(values))
+        return false;
+
+    sentence.derive(values, parameters);
+    return true;
+}
+
+using Parser = bool (*)(const std::string_view *, size_t, double *, double *);
+
+template <size_t... S>
+constexpr std::array<Parser, SENTENCE_COUNT> makeParsers(std::index_sequence<S...>)
+{
+    return { { &parse<S>... } };
+}
+
+static constexpr std::array<Parser, SENTENCE_COUNT> PARSERS = makeParsers(std::make_index_sequence<SENTENCE_COUNT>());
+
+constexpr bool withinLimits()
+{
+    for (const auto &sentence : SENTENCES)
+    {
+        if (sentence.fieldCount > MAX_FIELDS || sentence.parameterCount > MAX_PARAMETERS || sentence.tag.empty())
+            return false;
+    }
+    return true;
+}
+
+static_assert(withinLimits(), "sentence exceeds MAX_FIELDS or MAX_PARAMETERS");
+
+}
@@ -0,0 +1,92 @@
+/*
+    Lock-free single-producer/single-consumer ring queue
+
+    Author: Roman Dvořák <info@astrometers.cz>
+    Copyright (C) 2025 Astrometers
+*/
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+
+// Fixed-capacity queue for handing items between exactly one producer thread
+// and one consumer thread. Capacity must be a power of two.
+template <typename T, size_t Capacity>
+class SPSCQueue
+{
+    static_assert(Capacity >= 2 && (Capacity & (Capacity - 1)) == 0, "Capacity must be a power of two");
+
+public:
+    // Producer side. Returns false when the queue is full.
+    bool push(const T &item)
+    {
+        size_t head = writeIndex.load(std::memory_order_relaxed);
+        if (head - readIndex.load(std::memory_order_acquire) == Capacity)
+            return false;
+
+        slots[head & (Capacity - 1)] = item;
+        writeIndex.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Consumer side. Returns false when the queue is empty.
+    bool pop(T &item)
+    {
+        size_t tail = readIndex.load(std::memory_order_relaxed);
+        if (tail == writeIndex.load(std::memory_order_acquire))
+            return false;
+
+        item = slots[tail & (Capacity - 1)];
+        readIndex.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Producer side, zero-copy: fill the slot returned by claim() in place,
+    // then make it visible with publish(). Returns nullptr when the queue is full.
+    T *claim()
+    {
+        size_t head = writeIndex.load(std::memory_order_relaxed);
+        if (head - readIndex.load(std::memory_order_acquire) == Capacity)
+            return nullptr;
+
+        return &slots[head & (Capacity - 1)];
+    }
+
+    void publish()
+    {
+        writeIndex.store(writeIndex.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    }
+
+    // Consumer side, zero-copy: read the oldest item in place, then release() it.
+    // Returns nullptr when the queue is empty.
+    T *front()
+    {
+        size_t tail = readIndex.load(std::memory_order_relaxed);
+        if (tail == writeIndex.load(std::memory_order_acquire))
+            return nullptr;
+
+        return &slots[tail & (Capacity - 1)];
+    }
+
+    void release()
+    {
+        readIndex.store(readIndex.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    }
+
+    bool empty() const
+    {
+        return readIndex.load(std::memory_order_acquire) == writeIndex.load(std::memory_order_acquire);
+    }
+
+    // Only safe while neither side is running
+    void clear()
+    {
+        readIndex.store(writeIndex.load(std::memory_order_relaxed), std::memory_order_relaxed);
+    }
+
+private:
+    T slots[Capacity] {};
+    alignas(64) std::atomic<size_t> writeIndex{0};
+    alignas(64) std::atomic<size_t> readIndex{0};
+};
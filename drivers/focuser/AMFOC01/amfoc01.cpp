@@ -6,13 +6,44 @@
 */
 
 #include "amfoc01.h"
+#include "astrometers_proto.h"
 
 #include <memory>
+#include <chrono>
+#include <algorithm>
+#include <cerrno>
+#include <cmath>
 #include <cstring>
 #include <cstdlib>
 #include <termios.h>
 #include <unistd.h>
+#include <poll.h>
+#include <sys/eventfd.h>
 #include <sys/select.h>
+#include <sys/uio.h>
+
+// Nominal motor rates for FOCUS_SPEED 1..5 in steps/s, refined from observed motion
+static constexpr double SPEED_STEPS_PER_SEC[5] = { 250, 500, 1000, 2000, 4000 };
+
+// Shortest poll delay when landing a check on the predicted arrival (ms)
+static constexpr uint32_t MIN_POLL_DELAY = 20;
+
+// A move that makes no progress for this long is considered stopped (s)
+static constexpr double STALL_TIMEOUT = 2.0;
+
+// Command names as they appear on the wire, indexed by CommandType
+static const char *COMMAND_NAMES[] = { "GP", "GT", "SN", "SP", "FG" };
+
+// How often the diagnostics property is refreshed (s)
+static constexpr double DIAGNOSTICS_PERIOD = 5.0;
+
+static const char *DIAGNOSTICS_TAB = "Diagnostics";
+
+static uint32_t elapsedMicros(std::chrono::steady_clock::time_point since)
+{
+    using namespace std::chrono;
+    return static_cast<uint32_t>(duration_cast<microseconds>(steady_clock::now() - since).count());
+}
 
 // Indicate auto detection
 std::unique_ptr<AMFOC01> amfoc01(new AMFOC01());
@@ -64,13 +95,14 @@ AMFOC01::AMFOC01()
     serialConnection->registerHandshake([&]() { return callHandshake(); });
     registerConnection(serialConnection);
     
-    // Set serial parameters according to protocol: 9600 baud, 10ms timeout
+    // Set serial parameters according to protocol: 9600 baud, reply timeouts are adaptive
     serialConnection->setDefaultBaudRate(Connection::Serial::B_9600);
     serialConnection->setDefaultPort("/dev/ttyUSB0");
 }
 
 AMFOC01::~AMFOC01()
 {
+    stopIOThread();
     delete serialConnection;
 }
 
@@ -127,6 +159,65 @@ bool AMFOC01::initProperties()
     IUFillNumberVector(&TempCompSettingsNP, TempCompSettingsN, 2, getDeviceName(), "TEMP_SETTINGS",
                        "Compensation Settings", OPTIONS_TAB, IP_RW, 60, IPS_IDLE);
     
+    // Polling cadence: fast while moving, slow heartbeat when idle
+    IUFillNumber(&PollSettingsN[0], "MOVING_PERIOD", "Moving (ms)", "%.f", 20, 1000, 10, 100);
+    IUFillNumber(&PollSettingsN[1], "IDLE_PERIOD", "Idle Heartbeat (ms)", "%.f", 500, 60000, 500, 5000);
+    IUFillNumberVector(&PollSettingsNP, PollSettingsN, 2, getDeviceName(), "POLL_SETTINGS",
+                       "Polling", OPTIONS_TAB, IP_RW, 60, IPS_IDLE);
+    
+    // Temperature is sampled on its own, much slower schedule
+    IUFillNumber(&TempSamplingN[0], "TEMP_SAMPLE_PERIOD", "Sample Period (s)", "%.f", 1, 600, 1, 30);
+    IUFillNumber(&TempSamplingN[1], "TEMP_SMOOTHING", "Smoothing (s, 0=off)", "%.f", 0, 3600, 10, 0);
+    IUFillNumberVector(&TempSamplingNP, TempSamplingN, 2, getDeviceName(), "TEMP_SAMPLING",
+                       "Temperature Sampling", OPTIONS_TAB, IP_RW, 60, IPS_IDLE);
+    
+    // Slider drags are coalesced, only the latest target is sent
+    IUFillNumber(&MoveDispatchN[0], "MIN_INTERVAL", "Min Interval (ms)", "%.f", 0, 5000, 50, 200);
+    IUFillNumberVector(&MoveDispatchNP, MoveDispatchN, 1, getDeviceName(), "MOVE_DISPATCH",
+                       "Move Dispatch", OPTIONS_TAB, IP_RW, 60, IPS_IDLE);
+    
+    // Link diagnostics (read-only). Only a query has a reply to time, a command
+    // without one is complete when the kernel takes it and is just counted.
+    INumber *element = DiagnosticsN;
+    for (int i = 0; i < CMD_TYPES; i++)
+    {
+        static const char *suffixes[DIAG_PER_QUERY] = { "P50", "P95", "P99", "COUNT" };
+        static const char *labels[DIAG_PER_QUERY] = { "p50 (ms)", "p95 (ms)", "p99 (ms)", "count" };
+        
+        for (int j = (i < CMD_QUERIES ? 0 : DIAG_PER_QUERY - 1); j < DIAG_PER_QUERY; j++)
+        {
+            char elementName[MAXINDINAME];
+            char elementLabel[MAXINDILABEL];
+            snprintf(elementName, sizeof(elementName), "%s_%s", COMMAND_NAMES[i], suffixes[j]);
+            snprintf(elementLabel, sizeof(elementLabel), ":%s# %s", COMMAND_NAMES[i], labels[j]);
+            IUFillNumber(element++, elementName, elementLabel, j < 3 ? "%.2f" : "%.f", 0, 1e9, 0, 0);
+        }
+    }
+    
+    INumber *counters = &DiagnosticsN[DIAG_ELEMENTS - DIAG_COUNTERS];
+    IUFillNumber(&counters[0], "TIMEOUTS", "Timeouts", "%.f", 0, 1e9, 0, 0);
+    IUFillNumber(&counters[1], "PARTIAL_FRAMES", "Partial Frames", "%.f", 0, 1e9, 0, 0);
+    IUFillNumber(&counters[2], "GARBAGE_FRAMES", "Garbage Frames", "%.f", 0, 1e9, 0, 0);
+    IUFillNumber(&counters[3], "WRITE_FAILURES", "Write Failures", "%.f", 0, 1e9, 0, 0);
+    IUFillNumber(&counters[4], "READ_ERRORS", "Read Errors", "%.f", 0, 1e9, 0, 0);
+    IUFillNumberVector(&DiagnosticsNP, DiagnosticsN, DIAG_ELEMENTS,
+                       getDeviceName(), "LINK_DIAGNOSTICS", "Link Statistics", DIAGNOSTICS_TAB, IP_RO, 60, IPS_IDLE);
+    
+    // Reply timeouts, learned from observed reply times and clamped to the bounds
+    IUFillNumber(&ReplyTimeoutN[0], "GP_TIMEOUT", ":GP# (ms)", "%.1f", 0, 10000, 0, INITIAL_REPLY_TIMEOUT_MS);
+    IUFillNumber(&ReplyTimeoutN[1], "GT_TIMEOUT", ":GT# (ms)", "%.1f", 0, 10000, 0, INITIAL_REPLY_TIMEOUT_MS);
+    IUFillNumberVector(&ReplyTimeoutNP, ReplyTimeoutN, 2, getDeviceName(), "REPLY_TIMEOUT",
+                       "Reply Timeout", DIAGNOSTICS_TAB, IP_RO, 60, IPS_IDLE);
+    
+    IUFillNumber(&ReplyTimeoutBoundsN[0], "MIN", "Min (ms)", "%.f", 1, 1000, 1, 5);
+    IUFillNumber(&ReplyTimeoutBoundsN[1], "MAX", "Max (ms)", "%.f", 10, 5000, 10, 250);
+    IUFillNumberVector(&ReplyTimeoutBoundsNP, ReplyTimeoutBoundsN, 2, getDeviceName(), "REPLY_TIMEOUT_BOUNDS",
+                       "Reply Timeout Bounds", DIAGNOSTICS_TAB, IP_RW, 60, IPS_IDLE);
+    
+    IUFillSwitch(&DiagnosticsResetS[0], "RESET", "Reset", ISS_OFF);
+    IUFillSwitchVector(&DiagnosticsResetSP, DiagnosticsResetS, 1, getDeviceName(), "LINK_DIAGNOSTICS_RESET",
+                       "Statistics", DIAGNOSTICS_TAB, IP_RW, ISR_ATMOST1, 60, IPS_IDLE);
+
     addDebugControl();
     addConfigurationControl();
     
@@ -148,7 +239,18 @@ bool AMFOC01::updateProperties()
         defineProperty(&TempCompModeSP);
         defineProperty(&TempCoeffNP);
         defineProperty(&TempCompSettingsNP);
-        
+        defineProperty(&PollSettingsNP);
+        defineProperty(&TempSamplingNP);
+        defineProperty(&MoveDispatchNP);
+        defineProperty(&DiagnosticsNP);
+        defineProperty(&DiagnosticsResetSP);
+        defineProperty(&ReplyTimeoutNP);
+        defineProperty(&ReplyTimeoutBoundsNP);
+
+        // Serial traffic runs on the I/O thread from here on
+        if (!startIOThread())
+            LOG_ERROR("Failed to start serial I/O thread");
+            
         // Start periodic polling
         setupTimer();
     }
@@ -163,14 +265,30 @@ bool AMFOC01::updateProperties()
         deleteProperty(TempCompModeSP.name);
         deleteProperty(TempCoeffNP.name);
         deleteProperty(TempCompSettingsNP.name);
-        
+        deleteProperty(PollSettingsNP.name);
+        deleteProperty(TempSamplingNP.name);
+        deleteProperty(MoveDispatchNP.name);
+        deleteProperty(DiagnosticsNP.name);
+        deleteProperty(DiagnosticsResetSP.name);
+        deleteProperty(ReplyTimeoutNP.name);
+        deleteProperty(ReplyTimeoutBoundsNP.name);
+
         // Stop timer
         stopTimer();
+        cancelPendingMove();
+        stopIOThread();
     }
     
     return true;
 }
 
+bool AMFOC01::Disconnect()
+{
+    // The I/O thread must release the port before the connection closes it
+    stopIOThread();
+    return INDI::DefaultDevice::Disconnect();
+}
+
 const char *AMFOC01::getDefaultName()
 {
     return "AMFOC01";
@@ -178,11 +296,26 @@ const char *AMFOC01::getDefaultName()
 
 void AMFOC01::TimerHit()
 {
+    timerID = -1;
+    
     if (!isConnected())
         return;
         
-    // Poll current position from device
-    updateStatus();
+    // Sample every channel that is due, skipped while the previous poll is still queued
+    if (!pollInFlight)
+    {
+        auto now = std::chrono::steady_clock::now();
+        uint32_t channels = 0;
+        
+        for (int i = 0; i < CHANNEL_COUNT; i++)
+        {
+            if (now >= channelDue[i])
+                channels |= 1u << i;
+        }
+        
+        if (channels != 0)
+            queueStatusPoll(channels);
+    }
     
     // Perform internal temperature compensation if enabled
     if (tempCompEnabled && tempCompInDriver)
@@ -190,8 +323,13 @@ void AMFOC01::TimerHit()
         performDriverTempCompensation();
     }
     
+    // Refresh link statistics at a fixed, slow cadence
+    auto now = std::chrono::steady_clock::now();
+    if (std::chrono::duration<double>(now - lastDiagnosticsPublish).count() >= DIAGNOSTICS_PERIOD)
+        publishDiagnostics();
+        
     // Schedule next polling
-    SetTimer(getCurrentPollingPeriod());
+    scheduleNextPoll();
 }
 
 bool AMFOC01::ISNewNumber(const char *dev, const char *name, double values[], char *names[], int n)
@@ -266,8 +404,7 @@ bool AMFOC01::ISNewNumber(const char *dev, const char *name, double values[], ch
             
             if (syncPosition(static_cast<uint32_t>(FocusSyncN[0].value)))
             {
-                FocusSyncNP.s = IPS_OK;
-                LOGF_INFO("Position synced to %d", static_cast<int>(FocusSyncN[0].value));
+                FocusSyncNP.s = IPS_BUSY;
             }
             else
             {
@@ -310,6 +447,53 @@ bool AMFOC01::ISNewNumber(const char *dev, const char *name, double values[], ch
             return true;
         }
         
+        // Polling cadence
+        if (!strcmp(name, PollSettingsNP.name))
+        {
+            IUUpdateNumber(&PollSettingsNP, values, names, n);
+            PollSettingsNP.s = IPS_OK;
+            IDSetNumber(&PollSettingsNP, nullptr);
+            LOGF_INFO("Polling updated: moving=%.0fms, idle=%.0fms", PollSettingsN[0].value, PollSettingsN[1].value);
+            return true;
+        }
+        
+        // Temperature sampling
+        if (!strcmp(name, TempSamplingNP.name))
+        {
+            IUUpdateNumber(&TempSamplingNP, values, names, n);
+            TempSamplingNP.s = IPS_OK;
+            IDSetNumber(&TempSamplingNP, nullptr);
+            
+            // Apply the new period from now on
+            channelDue[CHANNEL_TEMPERATURE] = std::chrono::steady_clock::now();
+            LOGF_INFO("Temperature sampling updated: period=%.0fs, smoothing=%.0fs",
+                      TempSamplingN[0].value, TempSamplingN[1].value);
+            return true;
+        }
+        
+        // Reply timeout bounds
+        if (!strcmp(name, ReplyTimeoutBoundsNP.name))
+        {
+            IUUpdateNumber(&ReplyTimeoutBoundsNP, values, names, n);
+            if (ReplyTimeoutBoundsN[1].value < ReplyTimeoutBoundsN[0].value)
+                ReplyTimeoutBoundsN[1].value = ReplyTimeoutBoundsN[0].value;
+                
+            replyTimeoutMin = static_cast<uint32_t>(ReplyTimeoutBoundsN[0].value * 1000);
+            replyTimeoutMax = static_cast<uint32_t>(ReplyTimeoutBoundsN[1].value * 1000);
+            ReplyTimeoutBoundsNP.s = IPS_OK;
+            IDSetNumber(&ReplyTimeoutBoundsNP, nullptr);
+            return true;
+        }
+        
+        // Move dispatch interval
+        if (!strcmp(name, MoveDispatchNP.name))
+        {
+            IUUpdateNumber(&MoveDispatchNP, values, names, n);
+            MoveDispatchNP.s = IPS_OK;
+            IDSetNumber(&MoveDispatchNP, nullptr);
+            return true;
+        }
+        
         // Focus speed
         if (!strcmp(name, FocusSpeedNP.name))
         {
@@ -327,6 +511,17 @@ bool AMFOC01::ISNewSwitch(const char *dev, const char *name, ISState *states, ch
 {
     if (dev != nullptr && strcmp(dev, getDeviceName()) == 0)
     {
+        // Reset link statistics
+        if (!strcmp(name, DiagnosticsResetSP.name))
+        {
+            IUResetSwitch(&DiagnosticsResetSP);
+            resetDiagnostics();
+            DiagnosticsResetSP.s = IPS_OK;
+            IDSetSwitch(&DiagnosticsResetSP, nullptr);
+            LOG_INFO("Link statistics reset");
+            return true;
+        }
+        
         // Temperature compensation mode
         if (!strcmp(name, TempCompModeSP.name))
         {
@@ -368,6 +563,7 @@ bool AMFOC01::ISNewSwitch(const char *dev, const char *name, ISState *states, ch
 
 bool AMFOC01::callHandshake()
 {
+    resetRxBuffer();
     return getDeviceInfo();
 }
 
@@ -384,45 +580,108 @@ bool AMFOC01::getDeviceInfo()
     return true;
 }
 
-bool AMFOC01::getCurrentPosition()
+bool AMFOC01::queueStatusPoll(uint32_t channels)
 {
-    return getActualPosition(currentPosition);
+    using namespace std::chrono;
+    
+    IORequest request;
+    request.kind = IO_POLL;
+    request.channels = channels;
+    
+    // Due queries share one round trip, replies come back in order
+    if ((channels & (1u << CHANNEL_POSITION)) && !addGetPosition(request))
+        return false;
+    if ((channels & (1u << CHANNEL_TEMPERATURE)) && !addGetTemperature(request))
+        return false;
+        
+    pollInFlight = submitRequest(request, false);
+    if (!pollInFlight)
+        return false;
+        
+    auto now = steady_clock::now();
+    if (channels & (1u << CHANNEL_POSITION))
+        channelDue[CHANNEL_POSITION] = now + milliseconds(nextPollDelay());
+    if (channels & (1u << CHANNEL_TEMPERATURE))
+        channelDue[CHANNEL_TEMPERATURE] = now + duration_cast<steady_clock::duration>(duration<double>(TempSamplingN[0].value));
+        
+    return true;
 }
 
-bool AMFOC01::updateStatus()
+void AMFOC01::updateStatus(const IOResult& result)
 {
-    // Poll current position from device using :GP# command
-    uint32_t pos;
-    if (getActualPosition(pos))
+    if (!result.written)
     {
-        if (pos != currentPosition)
-        {
-            currentPosition = pos;
-            FocusAbsPosN[0].value = pos;
-            FocusAbsPosNP.s = IPS_OK;
-            IDSetNumber(&FocusAbsPosNP, nullptr);
-            LOGF_DEBUG("Position updated from device: %d", pos);
-        }
+        LOG_DEBUG("Failed to send status queries to device");
+        return;
     }
-    else
+    
+    int reply = 0;
+    
+    if (result.channels & (1u << CHANNEL_POSITION))
     {
-        LOG_DEBUG("Failed to read position from device");
+        FrameStatus status = result.statuses[reply];
+        const char *response = result.responses[reply++];
+        
+        uint32_t pos;
+        if (status == FRAME_OK && parsePosition(response, pos))
+        {
+            if (pos != currentPosition)
+            {
+                currentPosition = pos;
+                FocusAbsPosN[0].value = pos;
+                FocusAbsPosNP.s = (motionState == MOTION_MOVING) ? IPS_BUSY : IPS_OK;
+                IDSetNumber(&FocusAbsPosNP, nullptr);
+                LOGF_DEBUG("Position updated from device: %d", pos);
+            }
+            
+            updateMotion(pos);
+        }
+        else
+        {
+            LOGF_DEBUG("Failed to read position from device: %s", frameStatusName(status));
+        }
     }
     
-    // Also poll temperature if needed
-    double temp;
-    if (getTemperature(temp))
+    if (result.channels & (1u << CHANNEL_TEMPERATURE))
     {
-        if (temp != currentTemperature)
+        FrameStatus status = result.statuses[reply];
+        const char *response = result.responses[reply++];
+        
+        double temp;
+        if (status == FRAME_OK && parseTemperature(response, temp))
         {
-            currentTemperature = temp;
-            TemperatureN[0].value = temp;
-            TemperatureNP.s = IPS_OK;
-            IDSetNumber(&TemperatureNP, nullptr);
+            temp = filterTemperature(temp);
+            if (temp != currentTemperature)
+            {
+                currentTemperature = temp;
+                TemperatureN[0].value = temp;
+                TemperatureNP.s = IPS_OK;
+                IDSetNumber(&TemperatureNP, nullptr);
+            }
         }
     }
+}
+
+double AMFOC01::filterTemperature(double sample)
+{
+    using namespace std::chrono;
     
-    return true;
+    auto now = steady_clock::now();
+    double timeConstant = TempSamplingN[1].value;
+    
+    if (timeConstant <= 0 || !temperatureFiltered)
+    {
+        temperatureFiltered = true;
+        lastTemperatureSample = now;
+        return sample;
+    }
+    
+    // Weight by elapsed time so irregular sampling keeps the same time constant
+    double dt = duration<double>(now - lastTemperatureSample).count();
+    double alpha = 1.0 - exp(-dt / timeConstant);
+    lastTemperatureSample = now;
+    
+    return currentTemperature + alpha * (sample - currentTemperature);
 }
 
 bool AMFOC01::syncPosition(uint32_t position)
@@ -430,169 +689,728 @@ bool AMFOC01::syncPosition(uint32_t position)
     LOGF_DEBUG("Syncing position to %d", position);
     
     // Use :SP# command to set current position (synchronization)
-    if (setCurrentPosition(position))
-    {
-        currentPosition = position;
-        
-        // Update the absolute position display
-        FocusAbsPosN[0].value = position;
-        FocusAbsPosNP.s = IPS_OK;
-        IDSetNumber(&FocusAbsPosNP, nullptr);
-        
+    IORequest request;
+    request.kind = IO_SYNC;
+    request.value = position;
+    
+    if (!addSetCurrentPosition(request, position))
+        return false;
+    
+    return submitRequest(request, true);
+}
+
+bool AMFOC01::startIOThread()
+{
+    if (ioThread.joinable())
         return true;
+    
+    int fd = serialConnection->getPortFD();
+    if (fd < 0)
+        return false;
+    
+    ioWakeFD = eventfd(0, EFD_CLOEXEC);
+    completionFD = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    if (ioWakeFD < 0 || completionFD < 0)
+    {
+        LOGF_ERROR("Failed to create eventfd: %s", strerror(errno));
+        stopIOThread();
+        return false;
     }
     
-    return false;
+    highPriorityQueue.clear();
+    lowPriorityQueue.clear();
+    completionQueue.clear();
+    pollInFlight = false;
+    resetRxBuffer();
+    rxStale = false;
+    
+    // Reply timeouts are relearned for every connection
+    for (auto &estimator : replyTimeout)
+        estimator.reset(INITIAL_REPLY_TIMEOUT_MS * 1000);
+        
+    // Completions are delivered on the INDI event loop
+    completionCallbackID = IEAddCallback(completionFD, completionCallback, this);
+    
+    ioRunning = true;
+    ioThread = std::thread(&AMFOC01::ioThreadLoop, this, fd);
+    return true;
 }
 
-bool AMFOC01::getActualPosition(uint32_t& position)
+void AMFOC01::stopIOThread()
 {
-    char response[32];
-    if (sendAndReceive(":GP#", response, sizeof(response)))
+    ioRunning = false;
+    
+    if (ioThread.joinable())
     {
-        position = hexToUint32(response);
-        return true;
+        uint64_t wake = 1;
+        ssize_t rc = write(ioWakeFD, &wake, sizeof(wake));
+        INDI_UNUSED(rc);
+        ioThread.join();
     }
-    return false;
+    
+    if (completionCallbackID >= 0)
+    {
+        IERmCallback(completionCallbackID);
+        completionCallbackID = -1;
+    }
+    
+    if (ioWakeFD >= 0)
+    {
+        close(ioWakeFD);
+        ioWakeFD = -1;
+    }
+    
+    if (completionFD >= 0)
+    {
+        close(completionFD);
+        completionFD = -1;
+    }
+    
+    pollInFlight = false;
 }
 
-bool AMFOC01::getTemperature(double& temp)
+bool AMFOC01::submitRequest(const IORequest& request, bool highPriority)
 {
-    char response[32];
-    if (sendAndReceive(":GT#", response, sizeof(response)))
+    if (!ioRunning)
+        return false;
+    
+    auto &queue = highPriority ? highPriorityQueue : lowPriorityQueue;
+    if (!queue.push(request))
     {
-        uint32_t tempRaw = hexToUint32(response);
-        // Convert according to device specification
-        temp = (double)tempRaw / 100.0; // Assuming 0.01°C resolution
-        return true;
+        LOG_WARN("Serial I/O queue is full, command dropped");
+        return false;
     }
-    return false;
+    
+    uint64_t wake = 1;
+    ssize_t rc = write(ioWakeFD, &wake, sizeof(wake));
+    INDI_UNUSED(rc);
+    return true;
 }
 
-bool AMFOC01::setFuturePosition(uint32_t position)
+void AMFOC01::completionCallback(int fd, void *userpointer)
 {
-    return sendCommandWithParam("SN", position, 5);
+    // Reset the eventfd counter, the queue itself tells how much work is pending
+    uint64_t count;
+    ssize_t rc = read(fd, &count, sizeof(count));
+    INDI_UNUSED(rc);
+    
+    static_cast<AMFOC01 *>(userpointer)->processCompletions();
 }
 
-bool AMFOC01::setCurrentPosition(uint32_t position)
+void AMFOC01::processCompletions()
 {
-    return sendCommandWithParam("SP", position, 5);
+    IOResult result;
+    while (completionQueue.pop(result))
+        handleCompletion(result);
+}
+
+void AMFOC01::handleCompletion(const IOResult& result)
+{
+    switch (result.kind)
+    {
+        case IO_POLL:
+            pollInFlight = false;
+            updateStatus(result);
+            break;
+    
+        case IO_MOVE:
+            moveInFlight = false;
+            if (!result.written)
+            {
+                LOG_ERROR("Failed to start movement");
+                if (!movePending)
+                    endMotion(IPS_ALERT);
+            }
+            
+            // Send the newest target that arrived meanwhile
+            sendPendingMove();
+            break;
+    
+        case IO_SYNC:
+            if (result.written)
+            {
+                currentPosition = result.value;
+    
+                // Update the absolute position display
+                FocusAbsPosN[0].value = result.value;
+                FocusAbsPosNP.s = IPS_OK;
+                IDSetNumber(&FocusAbsPosNP, nullptr);
+    
+                FocusSyncNP.s = IPS_OK;
+                LOGF_INFO("Position synced to %d", static_cast<int>(result.value));
+            }
+            else
+            {
+                FocusSyncNP.s = IPS_ALERT;
+                LOG_ERROR("Failed to sync position.");
+            }
+            IDSetNumber(&FocusSyncNP, nullptr);
+            break;
+    }
 }
 
-bool AMFOC01::startMovement()
+void AMFOC01::ioThreadLoop(int fd)
 {
-    return sendCommand(":FG#");
+    IORequest request;
+    IOResult result;
+    
+    while (ioRunning)
+    {
+        // User commands always go ahead of background polling
+        if (highPriorityQueue.pop(request) || lowPriorityQueue.pop(request))
+        {
+            executeRequest(fd, request, result);
+    
+            while (!completionQueue.push(result) && ioRunning)
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    
+            uint64_t wake = 1;
+            ssize_t rc = write(completionFD, &wake, sizeof(wake));
+            INDI_UNUSED(rc);
+            continue;
+        }
+    
+        // Sleep until the main loop queues more work
+        struct pollfd pfd;
+        pfd.fd = ioWakeFD;
+        pfd.events = POLLIN;
+        pfd.revents = 0;
+    
+        if (poll(&pfd, 1, -1) > 0)
+        {
+            uint64_t count;
+            ssize_t rc = read(ioWakeFD, &count, sizeof(count));
+            INDI_UNUSED(rc);
+        }
+    }
 }
 
-bool AMFOC01::sendCommand(const char* cmd)
+void AMFOC01::executeRequest(int fd, const IORequest& request, IOResult& result)
 {
-    int fd = serialConnection->getPortFD();
-    if (fd < 0)
-        return false;
-        
-    int nbytes = write(fd, cmd, strlen(cmd));
-    if (nbytes != (int)strlen(cmd))
+    result.kind = request.kind;
+    result.value = request.value;
+    result.replies = request.replies;
+    for (int i = 0; i < MAX_PIPELINE; i++)
     {
-        LOGF_ERROR("Failed to send command: %s", cmd);
-        return false;
+        result.responses[i][0] = '\0';
+        result.statuses[i] = FRAME_ERROR;
     }
     
-    // Flush output buffer
-    tcdrain(fd);
-    return true;
+    // Frames left over from an earlier exchange cannot answer these commands.
+    // After a lost reply its late bytes may still sit in the kernel, drop those too.
+    rxTail = rxHead;
+    if (rxStale)
+    {
+        tcflush(fd, TCIFLUSH);
+        rxStale = false;
+    }
+
+    // All commands go to the kernel in one write(), without waiting for tcdrain()
+    auto start = std::chrono::steady_clock::now();
+    result.written = writeAll(fd, request.data, request.length);
+    if (!result.written)
+    {
+        linkWriteFailures.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    
+    // Commands without a reply are complete once the write returns. write() only
+    // hands them to the kernel, so that time says nothing about the link.
+    uint8_t replyTypes[MAX_PIPELINE];
+    int reply = 0;
+    for (int i = 0; i < request.commands; i++)
+    {
+        if (request.replyMask & (1u << i))
+            replyTypes[reply++] = request.types[i];
+        else
+            commandsWritten[request.types[i]].fetch_add(1, std::memory_order_relaxed);
+    }
+    
+    // The device answers strictly in order, so the n-th frame belongs to the n-th query
+    for (int i = 0; i < request.replies; i++)
+    {
+        ReplyTimeoutEstimator &estimator = replyTimeout[replyTypes[i]];
+        auto deadline = start + std::chrono::microseconds(estimator.timeout(replyTimeoutMin, replyTimeoutMax));
+        
+        result.statuses[i] = readResponse(fd, result.responses[i], RESPONSE_SIZE, deadline);
+        recordFrameStatus(result.statuses[i]);
+        
+        if (result.statuses[i] == FRAME_OK)
+        {
+            uint32_t micros = elapsedMicros(start);
+            commandLatency[replyTypes[i]].record(micros);
+            estimator.sample(micros);
+        }
+        else if (result.statuses[i] == FRAME_PARTIAL)
+        {
+            // The reply was on its way, only slower than estimated
+            estimator.backoff();
+        }
+        
+        if (result.statuses[i] != FRAME_OK && result.statuses[i] != FRAME_GARBAGE)
+        {
+            rxStale = true;
+            
+            // Once a reply is lost the rest can no longer be matched reliably
+            for (int j = i + 1; j < request.replies; j++)
+                result.statuses[j] = result.statuses[i];
+            break;
+        }
+    }
 }
 
-bool AMFOC01::sendCommandWithParam(const char* cmd, uint32_t param, int paramLength)
+bool AMFOC01::writeAll(int fd, const char* data, size_t length)
 {
-    char fullCmd[32];
-    char hexParam[16];
+    while (length > 0)
+    {
+        ssize_t nbytes = write(fd, data, length);
+        if (nbytes < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            return false;
+        }
     
-    uint32ToHex(param, hexParam, paramLength);
-    snprintf(fullCmd, sizeof(fullCmd), ":%s%s#", cmd, hexParam);
+        data += nbytes;
+        length -= nbytes;
+    }
     
-    LOGF_DEBUG("Sending command: %s", fullCmd);
-    return sendCommand(fullCmd);
+    return true;
 }
 
-bool AMFOC01::readResponse(char* response, int maxLen)
+AMFOC01::FrameStatus AMFOC01::readResponse(int fd, char* response, int maxLen,
+                                           std::chrono::steady_clock::time_point deadline)
 {
-    int fd = serialConnection->getPortFD();
-    if (fd < 0)
-        return false;
-        
-    memset(response, 0, maxLen);
+    using namespace std::chrono;
+    
+    response[0] = '\0';
     
-    int bytesRead = 0;
-    char c;
+    FrameStatus status;
     
-    // Read until we find '#' or timeout
-    while (bytesRead < maxLen - 1)
+    // Serve frames already sitting in the ring before touching the port
+    while (!extractFrame(response, maxLen, status))
     {
         fd_set readfds;
         struct timeval timeout;
-        
+    
         FD_ZERO(&readfds);
         FD_SET(fd, &readfds);
-        
-        // 10ms timeout as per protocol specification
-        timeout.tv_sec = 0;
-        timeout.tv_usec = 10000;
-        
+    
+        // Wait no longer than the adaptive reply deadline
+        auto remaining = duration_cast<microseconds>(deadline - steady_clock::now()).count();
+        if (remaining < 0)
+            remaining = 0;
+        timeout.tv_sec = remaining / 1000000;
+        timeout.tv_usec = remaining % 1000000;
+
         int result = select(fd + 1, &readfds, nullptr, nullptr, &timeout);
-        
+    
+        if (result < 0 && errno == EINTR)
+            continue;
+    
         if (result <= 0)
         {
-            if (bytesRead > 0)
-                break; // We got some data, might be incomplete response
-            return false;
+            // Drop an unterminated fragment, it would corrupt the next reply
+            bool partial = (rxHead != rxTail);
+            rxTail = rxHead;
+    
+            if (result < 0)
+                return FRAME_ERROR;
+            return partial ? FRAME_PARTIAL : FRAME_TIMEOUT;
         }
+    
+        if (fillRxBuffer(fd) <= 0)
+            return FRAME_ERROR;
+    }
+    
+    return status;
+}
+
+bool AMFOC01::extractFrame(char* response, int maxLen, FrameStatus& status)
+{
+    size_t available = rxHead - rxTail;
+    
+    for (size_t i = 0; i < available; i++)
+    {
+        if (rxBuffer[(rxTail + i) & RX_MASK] != '#')
+            continue;
+            
+        // Frame payload is everything before the terminator
+        bool valid = (i < static_cast<size_t>(maxLen));
+        size_t length = valid ? i : 0;
         
-        if (read(fd, &c, 1) == 1)
+        for (size_t j = 0; j < length; j++)
         {
-            if (c == '#')
-            {
-                response[bytesRead] = '\0';
-                return true;
-            }
-            else
-            {
-                response[bytesRead++] = c;
-            }
+            char c = rxBuffer[(rxTail + j) & RX_MASK];
+            if (c < 0x20 || c > 0x7E)
+                valid = false;
+            response[j] = c;
         }
-        else
-        {
+        
+        response[valid ? length : 0] = '\0';
+        rxTail += i + 1;
+        status = valid ? FRAME_OK : FRAME_GARBAGE;
+        return true;
+    }
+    
+    // A full ring without any terminator can never become a valid frame
+    if (available == RX_BUFFER_SIZE)
+    {
+        rxTail = rxHead;
+        response[0] = '\0';
+        status = FRAME_GARBAGE;
+        return true;
+    }
+    
+    return false;
+}
+
+ssize_t AMFOC01::fillRxBuffer(int fd)
+{
+    size_t freeSpace = RX_BUFFER_SIZE - (rxHead - rxTail);
+    if (freeSpace == 0)
+        return 0;
+        
+    // Free space may wrap around the end of the ring, read both parts at once
+    size_t head = rxHead & RX_MASK;
+    size_t firstPart = std::min(freeSpace, RX_BUFFER_SIZE - head);
+    
+    struct iovec iov[2];
+    iov[0].iov_base = rxBuffer + head;
+    iov[0].iov_len = firstPart;
+    iov[1].iov_base = rxBuffer;
+    iov[1].iov_len = freeSpace - firstPart;
+    
+    ssize_t nbytes = readv(fd, iov, iov[1].iov_len > 0 ? 2 : 1);
+    if (nbytes > 0)
+        rxHead += nbytes;
+        
+    return nbytes;
+}
+
+void AMFOC01::recordFrameStatus(FrameStatus status)
+{
+    switch (status)
+    {
+        case FRAME_OK:
             break;
-        }
+        case FRAME_TIMEOUT:
+            linkTimeouts.fetch_add(1, std::memory_order_relaxed);
+            break;
+        case FRAME_PARTIAL:
+            linkPartialFrames.fetch_add(1, std::memory_order_relaxed);
+            break;
+        case FRAME_GARBAGE:
+            linkGarbageFrames.fetch_add(1, std::memory_order_relaxed);
+            break;
+        case FRAME_ERROR:
+            linkReadErrors.fetch_add(1, std::memory_order_relaxed);
+            break;
+    }
+}
+
+void AMFOC01::publishDiagnostics()
+{
+    lastDiagnosticsPublish = std::chrono::steady_clock::now();
+    
+    for (int i = 0; i < CMD_QUERIES; i++)
+    {
+        INumber *values = &DiagnosticsN[i * DIAG_PER_QUERY];
+        values[0].value = commandLatency[i].percentile(50) / 1000.0;
+        values[1].value = commandLatency[i].percentile(95) / 1000.0;
+        values[2].value = commandLatency[i].percentile(99) / 1000.0;
+        values[3].value = commandLatency[i].count();
     }
+    for (int i = CMD_QUERIES; i < CMD_TYPES; i++)
+        DiagnosticsN[CMD_QUERIES * DIAG_PER_QUERY + i - CMD_QUERIES].value = commandsWritten[i].load(std::memory_order_relaxed);
+        
+    INumber *counters = &DiagnosticsN[DIAG_ELEMENTS - DIAG_COUNTERS];
+    counters[0].value = linkTimeouts.load(std::memory_order_relaxed);
+    counters[1].value = linkPartialFrames.load(std::memory_order_relaxed);
+    counters[2].value = linkGarbageFrames.load(std::memory_order_relaxed);
+    counters[3].value = linkWriteFailures.load(std::memory_order_relaxed);
+    counters[4].value = linkReadErrors.load(std::memory_order_relaxed);
+    
+    bool errors = counters[0].value + counters[1].value + counters[2].value + counters[3].value + counters[4].value > 0;
+    DiagnosticsNP.s = errors ? IPS_BUSY : IPS_OK;
+    IDSetNumber(&DiagnosticsNP, nullptr);
     
-    response[bytesRead] = '\0';
-    return bytesRead > 0;
+    ReplyTimeoutN[0].value = replyTimeout[CMD_GP].timeout(replyTimeoutMin, replyTimeoutMax) / 1000.0;
+    ReplyTimeoutN[1].value = replyTimeout[CMD_GT].timeout(replyTimeoutMin, replyTimeoutMax) / 1000.0;
+    ReplyTimeoutNP.s = IPS_OK;
+    IDSetNumber(&ReplyTimeoutNP, nullptr);
+}
+
+void AMFOC01::resetDiagnostics()
+{
+    for (auto &histogram : commandLatency)
+        histogram.reset();
+    for (auto &count : commandsWritten)
+        count = 0;
+        
+    linkTimeouts = 0;
+    linkPartialFrames = 0;
+    linkGarbageFrames = 0;
+    linkWriteFailures = 0;
+    linkReadErrors = 0;
+    
+    publishDiagnostics();
+}
+
+void AMFOC01::resetRxBuffer()
+{
+    rxHead = 0;
+    rxTail = 0;
+}
+
+const char *AMFOC01::frameStatusName(FrameStatus status)
+{
+    switch (status)
+    {
+        case FRAME_OK:
+            return "ok";
+        case FRAME_TIMEOUT:
+            return "timeout";
+        case FRAME_PARTIAL:
+            return "partial frame";
+        case FRAME_GARBAGE:
+            return "garbage frame";
+        case FRAME_ERROR:
+            return "read error";
+    }
+    return "unknown";
 }
 
-bool AMFOC01::sendAndReceive(const char* cmd, char* response, int maxLen)
+bool AMFOC01::appendCommand(IORequest& request, const char* cmd, bool expectReply)
 {
-    if (!sendCommand(cmd))
+    size_t cmdLength = strlen(cmd);
+    if (request.length + cmdLength > sizeof(request.data))
         return false;
         
-    return readResponse(response, maxLen);
+    int type = commandType(cmd);
+    if (type < 0 || request.commands >= MAX_PIPELINE)
+        return false;
+        
+    memcpy(request.data + request.length, cmd, cmdLength);
+    request.length += cmdLength;
+    request.types[request.commands] = static_cast<uint8_t>(type);
+    if (expectReply)
+    {
+        request.replyMask |= 1u << request.commands;
+        request.replies++;
+    }
+    request.commands++;
+    
+    return true;
+}
+
+int AMFOC01::commandType(const char* cmd)
+{
+    // Commands look like :XX...#, the two letters identify the type
+    if (cmd[0] != ':' || cmd[1] == '\0' || cmd[2] == '\0')
+        return -1;
+        
+    for (int i = 0; i < CMD_TYPES; i++)
+    {
+        if (cmd[1] == COMMAND_NAMES[i][0] && cmd[2] == COMMAND_NAMES[i][1])
+            return i;
+    }
+    
+    return -1;
+}
+
+bool AMFOC01::appendCommandWithParam(IORequest& request, const char* cmd, uint32_t param, int paramLength)
+{
+    char fullCmd[32];
+    
+    if (Astrometers::Proto::encodeCommand(cmd, param, paramLength, fullCmd, sizeof(fullCmd)) == 0)
+    {
+        LOGF_ERROR("Parameter %u does not fit command %s", param, cmd);
+        return false;
+    }
+    
+    LOGF_DEBUG("Sending command: %s", fullCmd);
+    return appendCommand(request, fullCmd, false);
+}
+
+bool AMFOC01::addGetPosition(IORequest& request)
+{
+    return appendCommand(request, ":GP#", true);
 }
 
-uint32_t AMFOC01::hexToUint32(const char* hex)
+bool AMFOC01::addGetTemperature(IORequest& request)
 {
-    return strtoul(hex, nullptr, 16);
+    return appendCommand(request, ":GT#", true);
 }
 
-void AMFOC01::uint32ToHex(uint32_t value, char* hex, int length)
+bool AMFOC01::addSetFuturePosition(IORequest& request, uint32_t position)
 {
-    snprintf(hex, length + 1, "%0*X", length, value);
+    return appendCommandWithParam(request, "SN", position, 5);
+}
+
+bool AMFOC01::addSetCurrentPosition(IORequest& request, uint32_t position)
+{
+    return appendCommandWithParam(request, "SP", position, 5);
+}
+
+bool AMFOC01::addStartMovement(IORequest& request)
+{
+    return appendCommand(request, ":FG#", false);
+}
+
+bool AMFOC01::parsePosition(const char* response, uint32_t& position)
+{
+    return Astrometers::Proto::decodeHex(response, position);
+}
+
+bool AMFOC01::parseTemperature(const char* response, double& temperature)
+{
+    uint32_t tempRaw;
+    if (!Astrometers::Proto::decodeHex(response, tempRaw))
+        return false;
+        
+    // Convert according to device specification
+    temperature = (double)tempRaw / 100.0; // Assuming 0.01°C resolution
+    return true;
 }
 
 void AMFOC01::setupTimer()
 {
+    motionState = MOTION_IDLE;
+    idlePollDelay = getCurrentPollingPeriod();
+    temperatureFiltered = false;
+    
+    // Sample every channel right after connecting
+    for (int i = 0; i < CHANNEL_COUNT; i++)
+        channelDue[i] = std::chrono::steady_clock::now();
+        
+    scheduleNextPoll();
+}
+
+void AMFOC01::scheduleNextPoll()
+{
+    using namespace std::chrono;
+    
     if (timerID > 0)
         RemoveTimer(timerID);
         
-    timerID = SetTimer(getCurrentPollingPeriod());
+    // Wake up for whichever channel is due first
+    auto due = *std::min_element(channelDue, channelDue + CHANNEL_COUNT);
+    auto delay = duration_cast<milliseconds>(due - steady_clock::now()).count();
+    
+    if (delay < MIN_POLL_DELAY)
+        delay = MIN_POLL_DELAY;
+        
+    timerID = SetTimer(static_cast<uint32_t>(delay));
+}
+
+uint32_t AMFOC01::nextPollDelay()
+{
+    using namespace std::chrono;
+    
+    if (motionState == MOTION_MOVING)
+    {
+        uint32_t movingPeriod = static_cast<uint32_t>(PollSettingsN[0].value);
+        
+        // Land a check right on the predicted arrival, otherwise keep polling fast
+        auto untilArrival = duration_cast<milliseconds>(moveETA - steady_clock::now()).count();
+        if (untilArrival > 0 && untilArrival < movingPeriod)
+            return std::max(static_cast<uint32_t>(untilArrival), MIN_POLL_DELAY);
+            
+        return movingPeriod;
+    }
+    
+    // Idle: back off exponentially towards the heartbeat
+    uint32_t heartbeat = static_cast<uint32_t>(PollSettingsN[1].value);
+    uint32_t delay = std::min(idlePollDelay, heartbeat);
+    idlePollDelay = std::min(idlePollDelay * 2, heartbeat);
+    return delay;
+}
+
+double AMFOC01::stepsPerSecond() const
+{
+    int speed = static_cast<int>(FocusSpeedN[0].value);
+    speed = std::max(1, std::min(5, speed));
+    return SPEED_STEPS_PER_SEC[speed - 1];
+}
+
+void AMFOC01::beginMotion(uint32_t target)
+{
+    using namespace std::chrono;
+    
+    auto now = steady_clock::now();
+    uint32_t distance = (target > currentPosition) ? target - currentPosition : currentPosition - target;
+    
+    motionState = MOTION_MOVING;
+    targetPosition = target;
+    moveStartPosition = currentPosition;
+    lastMotionPosition = currentPosition;
+    moveStartTime = now;
+    lastProgressTime = now;
+    moveETA = now + duration_cast<steady_clock::duration>(duration<double>(distance / stepsPerSecond()));
+    
+    LOGF_DEBUG("Move of %u steps, expected to take %.2fs", distance, distance / stepsPerSecond());
+    
+    // Switch to fast polling right away instead of waiting out an idle period
+    channelDue[CHANNEL_POSITION] = now + milliseconds(nextPollDelay());
+    scheduleNextPoll();
+}
+
+void AMFOC01::updateMotion(uint32_t position)
+{
+    using namespace std::chrono;
+    
+    // A newer target is still waiting to be sent
+    if (motionState != MOTION_MOVING || movePending)
+        return;
+        
+    auto now = steady_clock::now();
+    
+    if (position == targetPosition)
+    {
+        LOGF_INFO("Focuser reached position %u", position);
+        endMotion(IPS_OK);
+        return;
+    }
+    
+    if (position != lastMotionPosition)
+    {
+        lastMotionPosition = position;
+        lastProgressTime = now;
+        
+        // Refine the arrival estimate from the rate observed so far
+        double elapsed = duration<double>(now - moveStartTime).count();
+        uint32_t travelled = (position > moveStartPosition) ? position - moveStartPosition : moveStartPosition - position;
+        uint32_t remaining = (targetPosition > position) ? targetPosition - position : position - targetPosition;
+        if (elapsed > 0 && travelled > 0)
+        {
+            double rate = travelled / elapsed;
+            moveETA = now + duration_cast<steady_clock::duration>(duration<double>(remaining / rate));
+        }
+    }
+    else if (duration<double>(now - lastProgressTime).count() > STALL_TIMEOUT)
+    {
+        LOGF_WARN("Focuser stopped at %u before reaching %u", position, targetPosition);
+        endMotion(IPS_ALERT);
+    }
+}
+
+void AMFOC01::endMotion(IPState state)
+{
+    motionState = MOTION_IDLE;
+    idlePollDelay = getCurrentPollingPeriod();
+    
+    if (FocusAbsPosNP.s == IPS_BUSY)
+    {
+        FocusAbsPosNP.s = state;
+        IDSetNumber(&FocusAbsPosNP, nullptr);
+    }
+    
+    if (FocusRelPosNP.s == IPS_BUSY)
+    {
+        FocusRelPosNP.s = state;
+        IDSetNumber(&FocusRelPosNP, nullptr);
+    }
 }
 
 void AMFOC01::stopTimer()
@@ -608,21 +1426,81 @@ bool AMFOC01::gotoAbsolutePosition(uint32_t position)
 {
     LOGF_DEBUG("Moving to absolute position: %d", position);
     
-    // Send :SN# command to set future position
-    if (!setFuturePosition(position))
-    {
-        LOG_ERROR("Failed to set future position");
+    if (!ioRunning)
         return false;
-    }
+        
+    // Latest wins: replace whatever target is still waiting to be sent
+    pendingTarget = position;
+    movePending = true;
     
-    // Send :FG# command to start movement
-    if (!startMovement())
-    {
-        LOG_ERROR("Failed to start movement");
+    return flushPendingMove();
+}
+
+bool AMFOC01::dispatchMove(uint32_t position)
+{
+    // :SN# sets the future position and :FG# starts the movement
+    IORequest request;
+    request.kind = IO_MOVE;
+    request.value = position;
+    
+    if (!addSetFuturePosition(request, position) || !addStartMovement(request))
+        return false;
+        
+    if (!submitRequest(request, true))
         return false;
+        
+    moveInFlight = true;
+    lastMoveDispatch = std::chrono::steady_clock::now();
+    beginMotion(position);
+    return true;
+}
+
+bool AMFOC01::flushPendingMove()
+{
+    using namespace std::chrono;
+    
+    if (!movePending || moveInFlight || moveDispatchTimerID >= 0)
+        return true;
+        
+    // Respect the minimum interval between moves, the timer retries when it expires
+    auto sinceLast = duration_cast<milliseconds>(steady_clock::now() - lastMoveDispatch).count();
+    auto minInterval = static_cast<long>(MoveDispatchN[0].value);
+    if (sinceLast < minInterval)
+    {
+        moveDispatchTimerID = IEAddTimer(static_cast<int>(minInterval - sinceLast), moveDispatchTimer, this);
+        return true;
     }
     
-    return true;
+    movePending = false;
+    return dispatchMove(pendingTarget);
+}
+
+void AMFOC01::cancelPendingMove()
+{
+    movePending = false;
+    moveInFlight = false;
+    
+    if (moveDispatchTimerID >= 0)
+    {
+        IERmTimer(moveDispatchTimerID);
+        moveDispatchTimerID = -1;
+    }
+}
+
+void AMFOC01::moveDispatchTimer(void *userpointer)
+{
+    AMFOC01 *driver = static_cast<AMFOC01 *>(userpointer);
+    driver->moveDispatchTimerID = -1;
+    driver->sendPendingMove();
+}
+
+void AMFOC01::sendPendingMove()
+{
+    if (!flushPendingMove())
+    {
+        LOG_ERROR("Failed to queue movement");
+        endMotion(IPS_ALERT);
+    }
 }
 
 bool AMFOC01::gotoRelativePosition(int32_t steps)
@@ -10,7 +10,15 @@
 #include <libindi/defaultdevice.h>
 #include <libindi/connectionplugins/connectionserial.h>
 #include <libindi/connectionplugins/connectiontcp.h>
+#include <atomic>
+#include <chrono>
 #include <ctime>
+#include <thread>
+#include <sys/types.h>
+
+#include "latencyhistogram.h"
+#include "replytimeout.h"
+#include "spscqueue.h"
 
 class AMFOC01 : public INDI::DefaultDevice
 {
@@ -25,6 +33,17 @@ public:
     
     virtual bool ISNewNumber(const char *dev, const char *name, double values[], char *names[], int n) override;
     virtual bool ISNewSwitch(const char *dev, const char *name, ISState *states, char *names[], int n) override;
+    virtual bool Disconnect() override;
+
+    // Outcome of reading one '#'-terminated reply frame
+    enum FrameStatus
+    {
+        FRAME_OK,       // Complete, printable frame
+        FRAME_TIMEOUT,  // Nothing received within the timeout
+        FRAME_PARTIAL,  // Some bytes received but no terminator before the timeout
+        FRAME_GARBAGE,  // Terminated frame that is too long or contains non-printable bytes
+        FRAME_ERROR     // Port closed or read failure
+    };
 
 private:
     // Connection
@@ -62,6 +81,45 @@ private:
     INumberVectorProperty TempCompSettingsNP;
     INumber TempCompSettingsN[2]; // Period, Threshold
     
+    // Polling cadence
+    INumberVectorProperty PollSettingsNP;
+    INumber PollSettingsN[2]; // Moving period, idle heartbeat (ms)
+    
+    INumberVectorProperty TempSamplingNP;
+    INumber TempSamplingN[2]; // Period, smoothing time constant (s)
+    
+    INumberVectorProperty MoveDispatchNP;
+    INumber MoveDispatchN[1]; // Minimum interval between move commands (ms)
+    
+    // Link diagnostics: p50/p95/p99/count of the reply time per query, a count
+    // per command without a reply, then error counters. Queries come first.
+    enum CommandType
+    {
+        CMD_GP,
+        CMD_GT,
+        CMD_SN,
+        CMD_SP,
+        CMD_FG,
+        CMD_TYPES
+    };
+    
+    static constexpr int CMD_QUERIES = 2;       // :GP# and :GT#, the only commands answered
+    static constexpr int DIAG_PER_QUERY = 4;
+    static constexpr int DIAG_COUNTERS = 5;
+    static constexpr int DIAG_ELEMENTS = CMD_QUERIES * DIAG_PER_QUERY + (CMD_TYPES - CMD_QUERIES) + DIAG_COUNTERS;
+    INumberVectorProperty DiagnosticsNP;
+    INumber DiagnosticsN[DIAG_ELEMENTS];
+    
+    ISwitchVectorProperty DiagnosticsResetSP;
+    ISwitch DiagnosticsResetS[1];
+    
+    // Adaptive reply timeouts for the queries :GP# and :GT#
+    INumberVectorProperty ReplyTimeoutNP;
+    INumber ReplyTimeoutN[2];
+    
+    INumberVectorProperty ReplyTimeoutBoundsNP;
+    INumber ReplyTimeoutBoundsN[2]; // Min, max (ms)
+
     // Internal state variables
     uint32_t currentPosition{0};
     double currentTemperature{0.0};
@@ -74,18 +132,148 @@ private:
     time_t lastTempCompTime{0};
     int timerID{-1};
     
-    // Communication methods
-    bool sendCommand(const char* cmd);
-    bool sendCommandWithParam(const char* cmd, uint32_t param, int paramLength = 4);
-    bool readResponse(char* response, int maxLen);
-    bool sendAndReceive(const char* cmd, char* response, int maxLen);
-    bool getActualPosition(uint32_t& position);      // :GP#
-    bool getTemperature(double& temp);               // :GT#
-    bool setFuturePosition(uint32_t position);       // :SN<value>#
-    bool setCurrentPosition(uint32_t position);      // :SP<value>#
-    bool startMovement();                            // :FG#
-    uint32_t hexToUint32(const char* hex);
-    void uint32ToHex(uint32_t value, char* hex, int length);
+    // Motion state machine, driven by position polls
+    enum MotionState
+    {
+        MOTION_IDLE,
+        MOTION_MOVING
+    };
+    
+    MotionState motionState{MOTION_IDLE};
+    uint32_t targetPosition{0};
+    uint32_t moveStartPosition{0};
+    uint32_t lastMotionPosition{0};
+    std::chrono::steady_clock::time_point moveStartTime;
+    std::chrono::steady_clock::time_point lastProgressTime;
+    std::chrono::steady_clock::time_point moveETA;   // predicted arrival
+    uint32_t idlePollDelay{1000};                    // ms, grows towards the heartbeat
+    
+    // Latest-wins move coalescing: while a move is in flight, newer targets
+    // replace the pending one instead of queueing behind it
+    bool moveInFlight{false};
+    bool movePending{false};
+    uint32_t pendingTarget{0};
+    std::chrono::steady_clock::time_point lastMoveDispatch;
+    int moveDispatchTimerID{-1};
+    
+    // Link statistics, recorded by the I/O thread
+    LatencyHistogram commandLatency[CMD_QUERIES];
+    std::atomic<uint32_t> commandsWritten[CMD_TYPES] {};   // commands without a reply, nothing to time
+    std::atomic<uint32_t> linkTimeouts{0};
+    std::atomic<uint32_t> linkPartialFrames{0};
+    std::atomic<uint32_t> linkGarbageFrames{0};
+    std::atomic<uint32_t> linkWriteFailures{0};
+    std::atomic<uint32_t> linkReadErrors{0};
+    std::chrono::steady_clock::time_point lastDiagnosticsPublish;
+    
+    // Reply timeout per command type, learned by the I/O thread
+    ReplyTimeoutEstimator replyTimeout[CMD_TYPES];
+    std::atomic<uint32_t> replyTimeoutMin{5000};    // us
+    std::atomic<uint32_t> replyTimeoutMax{250000};  // us
+    bool rxStale{false}; // a reply was lost, late bytes may still be on the way
+
+    // Telemetry channels sampled at independent rates
+    enum TelemetryChannel
+    {
+        CHANNEL_POSITION,
+        CHANNEL_TEMPERATURE,
+        CHANNEL_COUNT
+    };
+    
+    std::chrono::steady_clock::time_point channelDue[CHANNEL_COUNT];
+    
+    // Temperature smoothing (exponential moving average)
+    bool temperatureFiltered{false};
+    std::chrono::steady_clock::time_point lastTemperatureSample;
+    
+    // Receive ring buffer, kept across calls so bytes after a '#' are not lost.
+    // Owned by the I/O thread while it is running.
+    static constexpr size_t RX_BUFFER_SIZE = 256; // must be a power of two
+    static constexpr size_t RX_MASK = RX_BUFFER_SIZE - 1;
+    static constexpr int INITIAL_REPLY_TIMEOUT_MS = 50;
+    static constexpr int RESPONSE_SIZE = 32;
+    static constexpr int MAX_PIPELINE = 8;   // commands per transaction
+    char rxBuffer[RX_BUFFER_SIZE] {};
+    size_t rxHead{0}; // total bytes written into the ring
+    size_t rxTail{0}; // total bytes consumed from the ring
+    
+    // Work item for the I/O thread: commands written back to back in one write()
+    enum IOKind
+    {
+        IO_POLL,
+        IO_MOVE,
+        IO_SYNC
+    };
+    
+    struct IORequest
+    {
+        IOKind kind{IO_POLL};
+        uint32_t value{0};  // target or sync position
+        uint32_t channels{0}; // TelemetryChannel bits sampled by a poll
+        int replies{0};     // '#' frames the commands answer with, in order
+        int commands{0};
+        uint8_t types[MAX_PIPELINE] {};  // CommandType of each command
+        uint32_t replyMask{0};           // bit set for commands that answer
+        size_t length{0};
+        char data[MAX_PIPELINE * RESPONSE_SIZE] {};
+    };
+    
+    struct IOResult
+    {
+        IOKind kind{IO_POLL};
+        uint32_t value{0};
+        uint32_t channels{0};
+        bool written{false};
+        int replies{0};
+        FrameStatus statuses[MAX_PIPELINE] {};
+        char responses[MAX_PIPELINE][RESPONSE_SIZE] {};
+    };
+    
+    // I/O thread owning the port. User commands go to the high priority queue
+    // and always run before background polling.
+    SPSCQueue<IORequest, 16> highPriorityQueue;
+    SPSCQueue<IORequest, 16> lowPriorityQueue;
+    SPSCQueue<IOResult, 64> completionQueue;
+    std::thread ioThread;
+    std::atomic<bool> ioRunning{false};
+    int ioWakeFD{-1};          // eventfd, main loop -> I/O thread
+    int completionFD{-1};      // eventfd, I/O thread -> main loop
+    int completionCallbackID{-1};
+    bool pollInFlight{false};
+    
+    bool startIOThread();
+    void stopIOThread();
+    void ioThreadLoop(int fd);
+    bool submitRequest(const IORequest& request, bool highPriority);
+    static void completionCallback(int fd, void *userpointer);
+    void processCompletions();
+    void handleCompletion(const IOResult& result);
+    
+    // Runs on the I/O thread
+    void executeRequest(int fd, const IORequest& request, IOResult& result);
+    bool writeAll(int fd, const char* data, size_t length);
+    FrameStatus readResponse(int fd, char* response, int maxLen, std::chrono::steady_clock::time_point deadline);
+    bool extractFrame(char* response, int maxLen, FrameStatus& status);
+    ssize_t fillRxBuffer(int fd);
+    void resetRxBuffer();
+    static const char *frameStatusName(FrameStatus status);
+    void recordFrameStatus(FrameStatus status);
+    
+    // Link diagnostics
+    static int commandType(const char* cmd);
+    void publishDiagnostics();
+    void resetDiagnostics();
+
+    // Protocol commands, appended to a request
+    bool appendCommand(IORequest& request, const char* cmd, bool expectReply);
+    bool appendCommandWithParam(IORequest& request, const char* cmd, uint32_t param, int paramLength = 4);
+    bool addGetPosition(IORequest& request);                        // :GP#
+    bool addGetTemperature(IORequest& request);                     // :GT#
+    bool addSetFuturePosition(IORequest& request, uint32_t position);  // :SN<value>#
+    bool addSetCurrentPosition(IORequest& request, uint32_t position); // :SP<value>#
+    bool addStartMovement(IORequest& request);                      // :FG#
+    bool parsePosition(const char* response, uint32_t& position);
+    bool parseTemperature(const char* response, double& temperature);
     
     // Temperature compensation methods
     bool enableTempCompensationInFocuser(bool enable);
@@ -95,11 +283,25 @@ private:
     // Helper functions
     bool callHandshake();
     bool getDeviceInfo();
-    bool getCurrentPosition();
-    bool updateStatus();
+    bool queueStatusPoll(uint32_t channels);
+    double filterTemperature(double sample);
+    void updateStatus(const IOResult& result);
     bool syncPosition(uint32_t position);
     bool gotoAbsolutePosition(uint32_t position);
+    bool dispatchMove(uint32_t position);
+    bool flushPendingMove();
+    void sendPendingMove();
+    void cancelPendingMove();
+    static void moveDispatchTimer(void *userpointer);
     bool gotoRelativePosition(int32_t steps);
     void setupTimer();
     void stopTimer();
+    
+    // Motion tracking and adaptive polling
+    void beginMotion(uint32_t target);
+    void endMotion(IPState state);
+    void updateMotion(uint32_t position);
+    double stepsPerSecond() const;
+    uint32_t nextPollDelay();
+    void scheduleNextPoll();
 };
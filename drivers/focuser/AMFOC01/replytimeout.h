@@ -0,0 +1,75 @@
+/*
+    Adaptive reply timeout estimator
+
+    Author: Roman Dvořák <info@astrometers.cz>
+    Copyright (C) 2025 Astrometers
+*/
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+
+// Reply timeout learned from observed reply times, computed like the TCP
+// retransmission timeout (RFC 6298): smoothed RTT plus four times its mean
+// deviation. Updated by one thread, read by any.
+class ReplyTimeoutEstimator
+{
+public:
+    void reset(uint32_t initialMicros)
+    {
+        srtt = 0;
+        rttvar = 0;
+        hasSample = false;
+        backoffShift = 0;
+        base = initialMicros;
+        current.store(initialMicros, std::memory_order_relaxed);
+    }
+
+    // Feed the time from request to complete reply
+    void sample(uint32_t micros)
+    {
+        if (!hasSample)
+        {
+            srtt = micros;
+            rttvar = micros / 2.0;
+            hasSample = true;
+        }
+        else
+        {
+            rttvar = 0.75 * rttvar + 0.25 * std::fabs(srtt - micros);
+            srtt = 0.875 * srtt + 0.125 * micros;
+        }
+
+        backoffShift = 0;
+        base = static_cast<uint32_t>(srtt + std::max(GRANULARITY, 4.0 * rttvar));
+        current.store(base, std::memory_order_relaxed);
+    }
+
+    // The reply started but did not finish in time, the link is slower than estimated
+    void backoff()
+    {
+        if (backoffShift < MAX_BACKOFF_SHIFT)
+            backoffShift++;
+        current.store(base << backoffShift, std::memory_order_relaxed);
+    }
+
+    uint32_t timeout(uint32_t minMicros, uint32_t maxMicros) const
+    {
+        uint32_t value = current.load(std::memory_order_relaxed);
+        return std::min(std::max(value, minMicros), maxMicros);
+    }
+
+private:
+    static constexpr double GRANULARITY = 1000.0; // us
+    static constexpr int MAX_BACKOFF_SHIFT = 6;
+
+    double srtt{0};
+    double rttvar{0};
+    bool hasSample{false};
+    int backoffShift{0};
+    uint32_t base{0};
+    std::atomic<uint32_t> current{0};
+};
@@ -4,25 +4,52 @@
 */
 
 #include "amtest01.h"
+#include "astrometers_proto.h"
 #include "indicom.h"
 #include "libindi/connectionplugins/connectionserial.h"
 #include <termios.h>
+#include <fcntl.h>
+#include <sys/ioctl.h>
+#include <unistd.h>
 
+#include <algorithm>
+#include <cerrno>
+#include <cmath>
+#include <cstring>
+#include <ctime>
+#include <filesystem>
+#include <fstream>
 #include <memory>
+#include <random>
 #include <string>
 #include <vector>
 #include <sstream>
-#include <iostream>
 
 static std::unique_ptr<AMTEST01> amtest01(new AMTEST01());
 
+static const char *CAPTURE_TAB = "Capture";
+static const char *LATENCY_TAB = "Latency";
+static const char *LOAD_TAB = "Load";
+static const char *DECODER_TAB = "Decoder";
+
 AMTEST01::AMTEST01()
 {
     setVersion(1, 0);
+    
+    // Printing received lines is what this driver is for, so data is on by default
+    logLink = consoleLog.addCategory("LINK", Astrometers::LogLevel::Info);
+    logData = consoleLog.addCategory("DATA", Astrometers::LogLevel::Info);
+    consoleLog.start();
+    
+    // Lines are offered to the decoders in this order
+    decoders.reserve(2);
+    addDecoder(new SkySentenceDecoder());
+    addDecoder(new FocuserFrameDecoder());
 }
 
 AMTEST01::~AMTEST01()
 {
+    consoleLog.stop();
     delete serialConnection;
 }
 
@@ -51,6 +78,145 @@ bool AMTEST01::initProperties()
     IUFillSwitch(&ReadDataS[1], "STOP", "Stop Reading", ISS_OFF);
     IUFillSwitchVector(&ReadDataSP, ReadDataS, 2, getDeviceName(), "READ_DATA", "Data Reading", MAIN_CONTROL_TAB, IP_RW, ISR_1OFMANY, 60, IPS_IDLE);
 
+    // Console log levels: 0 off, 1 error, 2 warning, 3 info, 4 debug
+    int logCategories[] = { logLink, logData };
+    for (int i = 0; i < 2; i++)
+    {
+        const char *category = consoleLog.categoryName(logCategories[i]);
+        IUFillNumber(&LogLevelsN[i], category, category, "%.f", 0, 4, 1,
+                     static_cast<double>(consoleLog.level(logCategories[i])));
+    }
+    IUFillNumberVector(&LogLevelsNP, LogLevelsN, 2, getDeviceName(), "CONSOLE_LOG_LEVELS",
+                       "Console Log (0 off - 4 debug)", OPTIONS_TAB, IP_RW, 60, IPS_IDLE);
+
+    // Raw capture
+    IUFillText(&CaptureFileT[0], "DIRECTORY", "Directory", "/tmp/amtest01");
+    IUFillText(&CaptureFileT[1], "PREFIX", "Prefix", "capture");
+    IUFillTextVector(&CaptureFileTP, CaptureFileT, 2, getDeviceName(), "CAPTURE_FILE", "Capture File",
+                     CAPTURE_TAB, IP_RW, 60, IPS_IDLE);
+    
+    IUFillNumber(&CaptureRotateN[0], "SIZE", "Rotate at (MB)", "%.f", 1, 65536, 64, 256);
+    IUFillNumberVector(&CaptureRotateNP, CaptureRotateN, 1, getDeviceName(), "CAPTURE_ROTATE", "Rotation",
+                       CAPTURE_TAB, IP_RW, 60, IPS_IDLE);
+    
+    IUFillSwitch(&CaptureS[0], "START", "Start", ISS_OFF);
+    IUFillSwitch(&CaptureS[1], "STOP", "Stop", ISS_ON);
+    IUFillSwitchVector(&CaptureSP, CaptureS, 2, getDeviceName(), "CAPTURE_CONTROL", "Capture",
+                       CAPTURE_TAB, IP_RW, ISR_1OFMANY, 60, IPS_IDLE);
+    
+    IUFillNumber(&CaptureStatsN[0], "BYTES_PER_SECOND", "Bytes/s", "%.0f", 0, 1e9, 0, 0);
+    IUFillNumber(&CaptureStatsN[1], "LINES_PER_SECOND", "Lines/s", "%.1f", 0, 1e9, 0, 0);
+    IUFillNumber(&CaptureStatsN[2], "BYTES", "Bytes captured", "%.0f", 0, 1e18, 0, 0);
+    IUFillNumber(&CaptureStatsN[3], "FILES", "Files", "%.0f", 0, 1e9, 0, 0);
+    IUFillNumber(&CaptureStatsN[4], "DROPPED_BYTES", "Dropped bytes", "%.0f", 0, 1e18, 0, 0);
+    IUFillNumberVector(&CaptureStatsNP, CaptureStatsN, 5, getDeviceName(), "CAPTURE_STATISTICS", "Statistics",
+                       CAPTURE_TAB, IP_RO, 60, IPS_IDLE);
+
+    // Latency probe
+    IUFillSwitch(&ProbeModeS[PROBE_LOOPBACK], "LOOPBACK", "Loopback", ISS_ON);
+    IUFillSwitch(&ProbeModeS[PROBE_ECHO], "ECHO", "Echo command", ISS_OFF);
+    IUFillSwitchVector(&ProbeModeSP, ProbeModeS, 2, getDeviceName(), "PROBE_MODE", "Probe Mode",
+                       LATENCY_TAB, IP_RW, ISR_1OFMANY, 60, IPS_IDLE);
+    
+    IUFillText(&ProbeCommandT[0], "COMMAND", "Echo command", ":GP#");
+    IUFillText(&ProbeCommandT[1], "TERMINATOR", "Reply ends with", "#");
+    IUFillTextVector(&ProbeCommandTP, ProbeCommandT, 2, getDeviceName(), "PROBE_COMMAND", "Echo Command",
+                     LATENCY_TAB, IP_RW, 60, IPS_IDLE);
+    
+    IUFillNumber(&ProbeSettingsN[0], "RATE", "Probes/s", "%.1f", 0.1, 1000, 1, 10);
+    IUFillNumber(&ProbeSettingsN[1], "TIMEOUT", "Timeout (ms)", "%.f", 1, 60000, 100, 1000);
+    IUFillNumberVector(&ProbeSettingsNP, ProbeSettingsN, 2, getDeviceName(), "PROBE_SETTINGS", "Probe Settings",
+                       LATENCY_TAB, IP_RW, 60, IPS_IDLE);
+    
+    IUFillSwitch(&ProbeS[0], "START", "Start", ISS_OFF);
+    IUFillSwitch(&ProbeS[1], "STOP", "Stop", ISS_ON);
+    IUFillSwitchVector(&ProbeSP, ProbeS, 2, getDeviceName(), "PROBE_CONTROL", "Probe",
+                       LATENCY_TAB, IP_RW, ISR_1OFMANY, 60, IPS_IDLE);
+    
+    IUFillSwitch(&ProbeExportS[0], "EXPORT", "Write report", ISS_OFF);
+    IUFillSwitchVector(&ProbeExportSP, ProbeExportS, 1, getDeviceName(), "PROBE_EXPORT", "Report",
+                       LATENCY_TAB, IP_RW, ISR_ATMOST1, 60, IPS_IDLE);
+    
+    // Percentiles are bucket upper bounds, half an octave wide
+    const char *probeStats[][2] =
+    {
+        { "SENT", "Sent" }, { "RECEIVED", "Received" }, { "LOST", "Lost" },
+        { "MIN", "Min (ms)" }, { "MEAN", "Mean (ms)" }, { "P50", "P50 (ms)" }, { "P90", "P90 (ms)" },
+        { "P99", "P99 (ms)" }, { "P999", "P99.9 (ms)" }, { "MAX", "Max (ms)" },
+        { "STDDEV", "Std dev (ms)" }, { "JITTER", "Jitter (ms)" }
+    };
+    for (int i = 0; i < 12; i++)
+        IUFillNumber(&ProbeStatsN[i], probeStats[i][0], probeStats[i][1], i < 3 ? "%.f" : "%.3f", 0, 1e12, 0, 0);
+    IUFillNumberVector(&ProbeStatsNP, ProbeStatsN, 12, getDeviceName(), "PROBE_STATISTICS", "Round Trip",
+                       LATENCY_TAB, IP_RO, 60, IPS_IDLE);
+
+    // Load generator
+    IUFillText(&LoadScriptT[0], "COMMANDS", "Commands", ":GP# :GT#");
+    IUFillText(&LoadScriptT[1], "FILE", "Script file", "");
+    IUFillText(&LoadScriptT[2], "TERMINATOR", "Reply ends with", "#");
+    IUFillTextVector(&LoadScriptTP, LoadScriptT, 3, getDeviceName(), "LOAD_SCRIPT", "Script",
+                     LOAD_TAB, IP_RW, 60, IPS_IDLE);
+    
+    IUFillNumber(&LoadSettingsN[0], "RATE", "Commands/s (0 max)", "%.1f", 0, 100000, 10, 0);
+    IUFillNumber(&LoadSettingsN[1], "DEPTH", "Pipeline depth", "%.f", 1, 64, 1, 1);
+    IUFillNumber(&LoadSettingsN[2], "TIMEOUT", "Timeout (ms)", "%.f", 1, 60000, 100, 1000);
+    IUFillNumber(&LoadSettingsN[3], "COUNT", "Commands (0 endless)", "%.f", 0, 1e9, 1000, 0);
+    IUFillNumberVector(&LoadSettingsNP, LoadSettingsN, 4, getDeviceName(), "LOAD_SETTINGS", "Load Settings",
+                       LOAD_TAB, IP_RW, 60, IPS_IDLE);
+    
+    IUFillSwitch(&LoadReplyS[0], "ANY", "Any", ISS_OFF);
+    IUFillSwitch(&LoadReplyS[1], "HEX", "Hex number", ISS_ON);
+    IUFillSwitchVector(&LoadReplySP, LoadReplyS, 2, getDeviceName(), "LOAD_REPLY_FORMAT", "Valid Reply",
+                       LOAD_TAB, IP_RW, ISR_1OFMANY, 60, IPS_IDLE);
+    
+    IUFillSwitch(&LoadS[0], "START", "Start", ISS_OFF);
+    IUFillSwitch(&LoadS[1], "STOP", "Stop", ISS_ON);
+    IUFillSwitchVector(&LoadSP, LoadS, 2, getDeviceName(), "LOAD_CONTROL", "Load",
+                       LOAD_TAB, IP_RW, ISR_1OFMANY, 60, IPS_IDLE);
+    
+    IUFillNumber(&LoadStatsN[0], "SENT", "Sent", "%.f", 0, 1e18, 0, 0);
+    IUFillNumber(&LoadStatsN[1], "REPLIES", "Replies", "%.f", 0, 1e18, 0, 0);
+    IUFillNumber(&LoadStatsN[2], "TIMEOUTS", "Timeouts", "%.f", 0, 1e18, 0, 0);
+    IUFillNumber(&LoadStatsN[3], "MALFORMED", "Malformed", "%.f", 0, 1e18, 0, 0);
+    IUFillNumber(&LoadStatsN[4], "LATE", "Late", "%.f", 0, 1e18, 0, 0);
+    IUFillNumber(&LoadStatsN[5], "SENT_PER_SECOND", "Commands/s", "%.1f", 0, 1e9, 0, 0);
+    IUFillNumber(&LoadStatsN[6], "REPLIES_PER_SECOND", "Replies/s", "%.1f", 0, 1e9, 0, 0);
+    IUFillNumber(&LoadStatsN[7], "P50", "Reply P50 (ms)", "%.3f", 0, 1e9, 0, 0);
+    IUFillNumber(&LoadStatsN[8], "P99", "Reply P99 (ms)", "%.3f", 0, 1e9, 0, 0);
+    IUFillNumberVector(&LoadStatsNP, LoadStatsN, 9, getDeviceName(), "LOAD_STATISTICS", "Throughput",
+                       LOAD_TAB, IP_RO, 60, IPS_IDLE);
+
+    // Protocol decoders
+    IUFillSwitch(&DecoderS[0], "ENABLE", "Enable", ISS_ON);
+    IUFillSwitch(&DecoderS[1], "DISABLE", "Disable", ISS_OFF);
+    IUFillSwitchVector(&DecoderSP, DecoderS, 2, getDeviceName(), "DECODER_CONTROL", "Decoding",
+                       DECODER_TAB, IP_RW, ISR_1OFMANY, 60, IPS_IDLE);
+    
+    IUFillNumber(&DecoderIntervalN[0], "INTERVAL", "Publish every (s)", "%.f", 1, 3600, 1, 5);
+    IUFillNumberVector(&DecoderIntervalNP, DecoderIntervalN, 1, getDeviceName(), "DECODER_INTERVAL", "Cadence",
+                       DECODER_TAB, IP_RW, 60, IPS_IDLE);
+    
+    IUFillSwitch(&DecoderResetS[0], "RESET", "Reset statistics", ISS_OFF);
+    IUFillSwitchVector(&DecoderResetSP, DecoderResetS, 1, getDeviceName(), "DECODER_RESET", "Reset",
+                       DECODER_TAB, IP_RW, ISR_ATMOST1, 60, IPS_IDLE);
+    
+    IUFillNumber(&DecoderSummaryN[0], "LINES", "Lines decoded", "%.f", 0, 1e18, 0, 0);
+    IUFillNumber(&DecoderSummaryN[1], "UNRECOGNIZED", "Lines unrecognized", "%.f", 0, 1e18, 0, 0);
+    IUFillNumber(&DecoderSummaryN[2], "MESSAGES", "Messages", "%.f", 0, 1e18, 0, 0);
+    IUFillNumber(&DecoderSummaryN[3], "ERROR_RATE", "Parse errors (%)", "%.2f", 0, 100, 0, 0);
+    IUFillNumberVector(&DecoderSummaryNP, DecoderSummaryN, 4, getDeviceName(), "DECODER_SUMMARY", "Summary",
+                       DECODER_TAB, IP_RO, 60, IPS_IDLE);
+    
+    // One text per message type: count, rate, error share and arrival intervals
+    for (auto &channel : decoders)
+    {
+        for (int i = 0; i < channel.decoder->typeCount(); i++)
+            IUFillText(&channel.texts[i], channel.decoder->typeName(i), channel.decoder->typeName(i), "-");
+        snprintf(channel.propertyName, sizeof(channel.propertyName), "DECODE_%s", channel.decoder->name());
+        IUFillTextVector(&channel.property, channel.texts.get(), channel.decoder->typeCount(), getDeviceName(),
+                         channel.propertyName, channel.decoder->name(), DECODER_TAB, IP_RO, 60, IPS_IDLE);
+    }
+
     // Serial connection
     serialConnection = new Connection::Serial(this);
     serialConnection->registerHandshake([&]() { return Handshake(); });
@@ -73,31 +239,80 @@ bool AMTEST01::updateProperties()
         // Add properties when connected
         defineProperty(&StatusTP);
         defineProperty(&ReadDataSP);
-        
+        defineProperty(&LogLevelsNP);
+        defineProperty(&CaptureFileTP);
+        defineProperty(&CaptureRotateNP);
+        defineProperty(&CaptureSP);
+        defineProperty(&CaptureStatsNP);
+        defineProperty(&ProbeModeSP);
+        defineProperty(&ProbeCommandTP);
+        defineProperty(&ProbeSettingsNP);
+        defineProperty(&ProbeSP);
+        defineProperty(&ProbeExportSP);
+        defineProperty(&ProbeStatsNP);
+        defineProperty(&LoadScriptTP);
+        defineProperty(&LoadSettingsNP);
+        defineProperty(&LoadReplySP);
+        defineProperty(&LoadSP);
+        defineProperty(&LoadStatsNP);
+        defineProperty(&DecoderSP);
+        defineProperty(&DecoderIntervalNP);
+        defineProperty(&DecoderResetSP);
+        defineProperty(&DecoderSummaryNP);
+        for (auto &channel : decoders)
+            defineProperty(&channel.property);
+
         // Update status
         IUSaveText(&StatusT[1], "Connected");
         StatusTP.s = IPS_OK;
         IDSetText(&StatusTP, nullptr);
         
-        printf("[AMTEST01] Device connected successfully\n");
-        std::cout.flush();
+        consoleLog.log(logLink, Astrometers::LogLevel::Info, "Device connected successfully");
     }
     else
     {
+        // Close the capture, probe and load while their properties still exist
+        if (capture.isOpen())
+            stopCapture();
+        if (probing)
+            stopProbe();
+        if (loadRunning)
+            stopLoad();
+            
         // Remove properties when disconnected
         deleteProperty(StatusTP.name);
         deleteProperty(ReadDataSP.name);
+        deleteProperty(LogLevelsNP.name);
+        deleteProperty(CaptureFileTP.name);
+        deleteProperty(CaptureRotateNP.name);
+        deleteProperty(CaptureSP.name);
+        deleteProperty(CaptureStatsNP.name);
+        deleteProperty(ProbeModeSP.name);
+        deleteProperty(ProbeCommandTP.name);
+        deleteProperty(ProbeSettingsNP.name);
+        deleteProperty(ProbeSP.name);
+        deleteProperty(ProbeExportSP.name);
+        deleteProperty(ProbeStatsNP.name);
+        deleteProperty(LoadScriptTP.name);
+        deleteProperty(LoadSettingsNP.name);
+        deleteProperty(LoadReplySP.name);
+        deleteProperty(LoadSP.name);
+        deleteProperty(LoadStatsNP.name);
+        deleteProperty(DecoderSP.name);
+        deleteProperty(DecoderIntervalNP.name);
+        deleteProperty(DecoderResetSP.name);
+        deleteProperty(DecoderSummaryNP.name);
+        for (auto &channel : decoders)
+            deleteProperty(channel.property.name);
         
         // Stop reading if active
         if (isReading)
         {
-            isReading = false;
-            printf("[AMTEST01] Stopped reading data\n");
-            std::cout.flush();
+            stopReading();
+            consoleLog.log(logLink, Astrometers::LogLevel::Info, "Stopped reading data");
         }
         
-        printf("[AMTEST01] Device disconnected\n");
-        std::cout.flush();
+        consoleLog.log(logLink, Astrometers::LogLevel::Info, "Device disconnected");
     }
 
     return true;
@@ -108,8 +323,7 @@ bool AMTEST01::Handshake()
     if (isSimulation())
     {
         LOGF_INFO("Connected successfully to simulated %s.", getDeviceName());
-        printf("[AMTEST01] Connected to simulated device\n");
-        std::cout.flush();
+        consoleLog.log(logLink, Astrometers::LogLevel::Info, "Connected to simulated device");
         return true;
     }
 
@@ -119,57 +333,31 @@ bool AMTEST01::Handshake()
     if (PortFD < 0)
     {
         LOG_ERROR("Serial port not connected");
-        printf("[AMTEST01] ERROR: Serial port not connected\n");
-        std::cout.flush();
         return false;
     }
 
-    printf("[AMTEST01] Connected to serial port (FD: %d)\n", PortFD);
-    std::cout.flush();
-    
+    consoleLog.log(logLink, Astrometers::LogLevel::Info, "Connected to serial port (FD: %d)", PortFD);
+
     return true;
 }
 
 bool AMTEST01::sendCommand(const char *cmd)
 {
-    int nbytes_read = 0, nbytes_written = 0, tty_rc = 0;
-    char res[256] = {0};
+    int nbytes_written = 0, tty_rc = 0;
     LOGF_DEBUG("CMD <%s>", cmd);
 
-    if (!isSimulation())
-    {
-        tcflush(PortFD, TCIOFLUSH);
-        if ((tty_rc = tty_write_string(PortFD, cmd, &nbytes_written)) != TTY_OK)
-        {
-            char errorMessage[MAXRBUF];
-            tty_error_msg(tty_rc, errorMessage, MAXRBUF);
-            LOGF_ERROR("Serial write error: %s", errorMessage);
-            printf("[AMTEST01] Serial write error: %s\n", errorMessage);
-            std::cout.flush();
-            return false;
-        }
-    }
-
     if (isSimulation())
+        return true;
+        
+    // Write only: replies come back through the port callback like any other line
+    if ((tty_rc = tty_write_string(PortFD, cmd, &nbytes_written)) != TTY_OK)
     {
-        strncpy(res, "OK#", 8);
-        nbytes_read = 3;
-    }
-    else
-    {
-        if ((tty_rc = tty_read_section(PortFD, res, '#', 1, &nbytes_read)) != TTY_OK)
-        {
-            char errorMessage[MAXRBUF];
-            tty_error_msg(tty_rc, errorMessage, MAXRBUF);
-            LOGF_ERROR("Serial read error: %s", errorMessage);
-            // Don't print error for timeout - normal for continuous reading
-            return false;
-        }
+        char errorMessage[MAXRBUF];
+        tty_error_msg(tty_rc, errorMessage, MAXRBUF);
+        LOGF_ERROR("Serial write error: %s", errorMessage);
+        return false;
     }
 
-    res[nbytes_read - 1] = '\0';
-    LOGF_DEBUG("RES <%s>", res);
-
     return true;
 }
 
@@ -184,20 +372,23 @@ bool AMTEST01::ISNewSwitch(const char *dev, const char *name, ISState *states, c
             
             if (ReadDataS[0].s == ISS_ON) // Start reading
             {
-                isReading = true;
+                if (!isReading && !startReading())
+                {
+                    IUResetSwitch(&ReadDataSP);
+                    ReadDataSP.s = IPS_ALERT;
+                    IDSetSwitch(&ReadDataSP, nullptr);
+                    return true;
+                }
                 IUSaveText(&StatusT[1], "Reading Data");
                 ReadDataSP.s = IPS_BUSY;
-                printf("[AMTEST01] Started continuous data reading\n");
-                std::cout.flush();
-                SetTimer(100); // Read every 100ms
+                consoleLog.log(logLink, Astrometers::LogLevel::Info, "Started continuous data reading");
             }
             else // Stop reading
             {
-                isReading = false;
+                stopReading();
                 IUSaveText(&StatusT[1], "Connected");
                 ReadDataSP.s = IPS_OK;
-                printf("[AMTEST01] Stopped data reading\n");
-                std::cout.flush();
+                consoleLog.log(logLink, Astrometers::LogLevel::Info, "Stopped data reading");
             }
             
             IDSetSwitch(&ReadDataSP, nullptr);
@@ -205,91 +396,1279 @@ bool AMTEST01::ISNewSwitch(const char *dev, const char *name, ISState *states, c
             IDSetText(&StatusTP, nullptr);
             return true;
         }
+        
+        // Raw capture start/stop
+        if (!strcmp(name, CaptureSP.name))
+        {
+            IUUpdateSwitch(&CaptureSP, states, names, n);
+            
+            if (CaptureS[0].s == ISS_ON)
+            {
+                if (!capture.isOpen() && !startCapture())
+                {
+                    IUResetSwitch(&CaptureSP);
+                    CaptureS[1].s = ISS_ON;
+                    CaptureSP.s = IPS_ALERT;
+                    IDSetSwitch(&CaptureSP, nullptr);
+                    return true;
+                }
+                CaptureSP.s = IPS_BUSY;
+            }
+            else
+            {
+                stopCapture();
+                CaptureSP.s = IPS_OK;
+            }
+            
+            IDSetSwitch(&CaptureSP, nullptr);
+            return true;
+        }
+        
+        // Probe mode, applies to the next probe run
+        if (!strcmp(name, ProbeModeSP.name))
+        {
+            IUUpdateSwitch(&ProbeModeSP, states, names, n);
+            ProbeModeSP.s = IPS_OK;
+            IDSetSwitch(&ProbeModeSP, nullptr);
+            return true;
+        }
+        
+        // Latency probe start/stop
+        if (!strcmp(name, ProbeSP.name))
+        {
+            IUUpdateSwitch(&ProbeSP, states, names, n);
+            
+            if (ProbeS[0].s == ISS_ON)
+            {
+                if (!probing && !startProbe())
+                {
+                    IUResetSwitch(&ProbeSP);
+                    ProbeS[1].s = ISS_ON;
+                    ProbeSP.s = IPS_ALERT;
+                    IDSetSwitch(&ProbeSP, nullptr);
+                    return true;
+                }
+                ProbeSP.s = IPS_BUSY;
+            }
+            else
+            {
+                stopProbe();
+                ProbeSP.s = IPS_OK;
+            }
+            
+            IDSetSwitch(&ProbeSP, nullptr);
+            return true;
+        }
+        
+        // Decoding on/off
+        if (!strcmp(name, DecoderSP.name))
+        {
+            IUUpdateSwitch(&DecoderSP, states, names, n);
+            DecoderSP.s = IPS_OK;
+            IDSetSwitch(&DecoderSP, nullptr);
+            return true;
+        }
+        
+        // Decoder statistics reset
+        if (!strcmp(name, DecoderResetSP.name))
+        {
+            resetDecoders();
+            publishDecoders();
+            IUResetSwitch(&DecoderResetSP);
+            DecoderResetSP.s = IPS_OK;
+            IDSetSwitch(&DecoderResetSP, nullptr);
+            return true;
+        }
+        
+        // Reply format, picked up by the next reply
+        if (!strcmp(name, LoadReplySP.name))
+        {
+            IUUpdateSwitch(&LoadReplySP, states, names, n);
+            LoadReplySP.s = IPS_OK;
+            IDSetSwitch(&LoadReplySP, nullptr);
+            return true;
+        }
+        
+        // Load generator start/stop
+        if (!strcmp(name, LoadSP.name))
+        {
+            IUUpdateSwitch(&LoadSP, states, names, n);
+            
+            if (LoadS[0].s == ISS_ON)
+            {
+                if (!loadRunning && !startLoad())
+                {
+                    IUResetSwitch(&LoadSP);
+                    LoadS[1].s = ISS_ON;
+                    LoadSP.s = IPS_ALERT;
+                    IDSetSwitch(&LoadSP, nullptr);
+                    return true;
+                }
+                LoadSP.s = IPS_BUSY;
+            }
+            else
+            {
+                stopLoad();
+                LoadSP.s = IPS_OK;
+            }
+            
+            IDSetSwitch(&LoadSP, nullptr);
+            return true;
+        }
+        
+        // Latency report
+        if (!strcmp(name, ProbeExportSP.name))
+        {
+            ProbeExportSP.s = exportProbeReport() ? IPS_OK : IPS_ALERT;
+            IUResetSwitch(&ProbeExportSP);
+            IDSetSwitch(&ProbeExportSP, nullptr);
+            return true;
+        }
     }
 
     return INDI::DefaultDevice::ISNewSwitch(dev, name, states, names, n);
 }
 
-void AMTEST01::TimerHit()
+bool AMTEST01::ISNewNumber(const char *dev, const char *name, double values[], char *names[], int n)
 {
-    if (isConnected() && isReading)
+    if (dev != nullptr && strcmp(dev, getDeviceName()) == 0)
     {
-        readSerialData();
-        SetTimer(100); // Continue reading every 100ms
+        // Console log levels
+        if (!strcmp(name, LogLevelsNP.name))
+        {
+            IUUpdateNumber(&LogLevelsNP, values, names, n);
+            consoleLog.setLevel(logLink, static_cast<Astrometers::LogLevel>(LogLevelsN[0].value));
+            consoleLog.setLevel(logData, static_cast<Astrometers::LogLevel>(LogLevelsN[1].value));
+            LogLevelsNP.s = IPS_OK;
+            IDSetNumber(&LogLevelsNP, nullptr);
+            return true;
+        }
+        
+        // Decoder publish cadence
+        if (!strcmp(name, DecoderIntervalNP.name))
+        {
+            IUUpdateNumber(&DecoderIntervalNP, values, names, n);
+            DecoderIntervalNP.s = IPS_OK;
+            IDSetNumber(&DecoderIntervalNP, nullptr);
+            return true;
+        }
+        
+        // Load rate, depth, timeout and count, picked up as the load runs
+        if (!strcmp(name, LoadSettingsNP.name))
+        {
+            IUUpdateNumber(&LoadSettingsNP, values, names, n);
+            LoadSettingsNP.s = IPS_OK;
+            IDSetNumber(&LoadSettingsNP, nullptr);
+            return true;
+        }
+        
+        // Probe rate and timeout, picked up by the next probe
+        if (!strcmp(name, ProbeSettingsNP.name))
+        {
+            IUUpdateNumber(&ProbeSettingsNP, values, names, n);
+            ProbeSettingsNP.s = IPS_OK;
+            IDSetNumber(&ProbeSettingsNP, nullptr);
+            return true;
+        }
+        
+        // Rotation size, applies to the next capture
+        if (!strcmp(name, CaptureRotateNP.name))
+        {
+            IUUpdateNumber(&CaptureRotateNP, values, names, n);
+            CaptureRotateNP.s = IPS_OK;
+            IDSetNumber(&CaptureRotateNP, nullptr);
+            return true;
+        }
     }
+    
+    return INDI::DefaultDevice::ISNewNumber(dev, name, values, names, n);
 }
 
-bool AMTEST01::readSerialData()
+bool AMTEST01::ISNewText(const char *dev, const char *name, char *texts[], char *names[], int n)
 {
-    if (PortFD < 0)
+    if (dev != nullptr && strcmp(dev, getDeviceName()) == 0)
     {
-        return false;
+        // Capture location, applies to the next capture
+        if (!strcmp(name, CaptureFileTP.name))
+        {
+            IUUpdateText(&CaptureFileTP, texts, names, n);
+            CaptureFileTP.s = IPS_OK;
+            IDSetText(&CaptureFileTP, nullptr);
+            return true;
+        }
+        
+        // Load script, applies to the next load run
+        if (!strcmp(name, LoadScriptTP.name))
+        {
+            IUUpdateText(&LoadScriptTP, texts, names, n);
+            LoadScriptTP.s = IPS_OK;
+            IDSetText(&LoadScriptTP, nullptr);
+            return true;
+        }
+        
+        // Echo command, applies to the next probe run
+        if (!strcmp(name, ProbeCommandTP.name))
+        {
+            IUUpdateText(&ProbeCommandTP, texts, names, n);
+            ProbeCommandTP.s = IPS_OK;
+            IDSetText(&ProbeCommandTP, nullptr);
+            return true;
+        }
     }
+    
+    return INDI::DefaultDevice::ISNewText(dev, name, texts, names, n);
+}
 
-    char buffer[1024] = {0};
-    int nbytes_read = 0;
+void AMTEST01::debugTriggered(bool enable)
+{
+    INDI::DefaultDevice::debugTriggered(enable);
+    
+    // INDI debug opens up every console category
+    consoleLog.setDebug(enable);
+}
+
+void AMTEST01::TimerHit()
+{
+    if (!isConnected() || !isReading)
+    {
+        timerID = -1;
+        return;
+    }
     
     if (isSimulation())
     {
         // Generate some test data
         static int counter = 0;
-        snprintf(buffer, sizeof(buffer), "TEST_DATA_%d,temperature=%.1f,humidity=%.1f", 
+        char buffer[128];
+        int length = snprintf(buffer, sizeof(buffer), "TEST_DATA_%d,temperature=%.1f,humidity=%.1f\n", 
                 counter++, 20.0 + (counter % 10), 50.0 + (counter % 20));
-        nbytes_read = strlen(buffer);
-        processData(std::string(buffer));
-        return true;
+        if (capture.isOpen())
+            capture.append(buffer, length, std::chrono::duration_cast<std::chrono::nanoseconds>(
+                               std::chrono::steady_clock::now().time_since_epoch()).count());
+        buffer[length - 1] = '\0';
+        std::string line(buffer);
+        if (DecoderS[0].s == ISS_ON)
+            decodeLine(line, std::chrono::steady_clock::now());
+        processData(line);
     }
+    
+    auto now = std::chrono::steady_clock::now();
+    if (now - lastHeartbeat >= std::chrono::milliseconds(HEARTBEAT_MS))
+        publishHeartbeat();
+        
+    timerID = SetTimer(isSimulation() ? SIMULATION_MS : HEARTBEAT_MS);
+}
 
-    LOGF_DEBUG("Reading serial data from FD %d", PortFD);
+bool AMTEST01::startReading()
+{
+    ringHead = ringTail = ringScan = 0;
+    discardingLine = false;
+    linesReceived = linesReported = bytesDropped = 0;
+    lastData = lastHeartbeat = lastDecoderReport = std::chrono::steady_clock::now();
     
-    // Try to read a line of data (ending with newline)
-    int tty_rc = tty_read_section(PortFD, buffer, '\n', 3, &nbytes_read);
+    if (!isSimulation())
+    {
+        if (PortFD < 0)
+        {
+            LOG_ERROR("Serial port not connected");
+            return false;
+        }
+        
+        // The callback drains the port until it would block
+        portFlags = fcntl(PortFD, F_GETFL);
+        if (portFlags < 0 || fcntl(PortFD, F_SETFL, portFlags | O_NONBLOCK) < 0)
+        {
+            LOGF_ERROR("Cannot make serial port non-blocking: %s", strerror(errno));
+            portFlags = -1;
+            return false;
+        }
+        
+        // Drop whatever piled up while nobody was reading
+        tcflush(PortFD, TCIFLUSH);
+        portCallbackID = IEAddCallback(PortFD, portCallback, this);
+    }
+    
+    isReading = true;
+    if (timerID > 0)
+        RemoveTimer(timerID);
+    timerID = SetTimer(isSimulation() ? SIMULATION_MS : HEARTBEAT_MS);
+    return true;
+}
+
+void AMTEST01::stopReading()
+{
+    isReading = false;
+    stopCapture();
+    stopProbe();
+    stopLoad();
     
-    if (tty_rc == TTY_OK && nbytes_read > 0)
+    if (portCallbackID >= 0)
     {
-        buffer[nbytes_read - 1] = '\0'; // Remove newline
-        std::string dataLine(buffer);
-        processData(dataLine);
-        return true;
+        IERmCallback(portCallbackID);
+        portCallbackID = -1;
     }
-    else if (tty_rc == TTY_TIME_OUT)
+    
+    if (portFlags >= 0)
     {
-        // Timeout is normal when no data is available
-        return true;
+        if (PortFD >= 0)
+            fcntl(PortFD, F_SETFL, portFlags);
+        portFlags = -1;
     }
-    else if (tty_rc != TTY_OK)
+    
+    if (timerID > 0)
     {
-        char errorMessage[MAXRBUF];
-        tty_error_msg(tty_rc, errorMessage, MAXRBUF);
-        LOGF_DEBUG("Serial read error: %s", errorMessage);
+        RemoveTimer(timerID);
+        timerID = -1;
+    }
+    
+    if (bytesDropped > 0)
+        consoleLog.log(logLink, Astrometers::LogLevel::Warning, "%llu bytes dropped from overlong lines",
+                       static_cast<unsigned long long>(bytesDropped));
+}
+
+void AMTEST01::portCallback(int fd, void *userpointer)
+{
+    INDI_UNUSED(fd);
+    static_cast<AMTEST01 *>(userpointer)->readSerialData();
+}
+
+bool AMTEST01::readSerialData()
+{
+    if (PortFD < 0 || !isReading)
+        return false;
+        
+    // Read everything available, taking complete lines out as they arrive
+    while (true)
+    {
+        size_t used = ringTail - ringHead;
+        if (used == RING_SIZE)
+        {
+            // A single line filled the ring, drop it up to its newline
+            bytesDropped += used;
+            ringHead = ringScan = ringTail;
+            discardingLine = true;
+            used = 0;
+        }
+        
+        size_t offset = ringTail % RING_SIZE;
+        size_t space = std::min({ RING_SIZE - used, RING_SIZE - offset, READ_CHUNK_SIZE });
+        ssize_t n = read(PortFD, ring + offset, space);
+        
+        if (n > 0)
+        {
+            lastData = std::chrono::steady_clock::now();
+            if (capture.isOpen())
+                capture.append(ring + offset, n, std::chrono::duration_cast<std::chrono::nanoseconds>(
+                                   lastData.time_since_epoch()).count());
+            ringTail += n;
+            processLines();
+            continue;
+        }
+        
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+            break;
+            
+        // End of file or a real error: the device went away, stop watching it
+        if (n == 0)
+            consoleLog.log(logLink, Astrometers::LogLevel::Error, "Serial port closed by the device");
+        else
+            consoleLog.log(logLink, Astrometers::LogLevel::Error, "Serial read error: %s", strerror(errno));
+        stopReading();
+        IUResetSwitch(&ReadDataSP);
+        ReadDataSP.s = IPS_ALERT;
+        IDSetSwitch(&ReadDataSP, nullptr);
+        IUSaveText(&StatusT[1], "Read Error");
+        StatusTP.s = IPS_ALERT;
+        IDSetText(&StatusTP, nullptr);
         return false;
     }
     
+    // Replies free pipeline slots, refill them right away
+    if (loadRunning)
+        pumpLoad();
+        
     return true;
 }
 
+void AMTEST01::processLines()
+{
+    for (; ringScan != ringTail; ringScan++)
+    {
+        if (ring[ringScan % RING_SIZE] != lineTerminator)
+            continue;
+            
+        size_t length = ringScan - ringHead;
+        if (discardingLine)
+        {
+            bytesDropped += length + 1;
+            discardingLine = false;
+        }
+        else
+        {
+            // Copy out in at most two pieces, the line may wrap around the ring end
+            size_t offset = ringHead % RING_SIZE;
+            size_t first = std::min(length, RING_SIZE - offset);
+            lineBuffer.assign(ring + offset, first);
+            lineBuffer.append(ring, length - first);
+            
+            // Replies cut at another terminator may still be followed by a line break
+            lineBuffer.erase(0, lineBuffer.find_first_not_of("\r\n"));
+            if (!lineBuffer.empty() && lineBuffer.back() == '\r')
+                lineBuffer.pop_back();
+                
+            // Decoders see frames with their terminator, as they were on the wire
+            if (!lineBuffer.empty() && DecoderS[0].s == ISS_ON)
+            {
+                if (lineTerminator != '\n')
+                    lineBuffer.push_back(lineTerminator);
+                decodeLine(lineBuffer, lastData);
+                if (lineTerminator != '\n')
+                    lineBuffer.pop_back();
+            }
+                
+            // Probe and load replies are theirs, everything else is data
+            bool consumed = lineBuffer.empty() || (probing && handleProbeReply(lineBuffer)) ||
+                            (loadRunning && handleLoadReply(lineBuffer));
+            if (!consumed)
+                processData(lineBuffer);
+        }
+        
+        ringHead = ringScan + 1;
+    }
+}
+
 void AMTEST01::processData(const std::string& data)
 {
     if (data.empty())
         return;
         
-    // Print to console with timestamp
-    time_t rawtime;
-    struct tm * timeinfo;
-    char timestamp[80];
+    // Print to console, timestamped by the log writer, lines longer than a log
+    // message in pieces. A capture has every byte on disk already, echoing it
+    // as well only slows the driver down.
+    if (!capture.isOpen())
+    {
+        constexpr size_t piece = Astrometers::AsyncLog::MESSAGE_SIZE - 1;
+        for (size_t offset = 0; offset < data.size(); offset += piece)
+            consoleLog.log(logData, Astrometers::LogLevel::Info, "%.*s",
+                           static_cast<int>(std::min(piece, data.size() - offset)), data.data() + offset);
+    }
+    
+    // LAST_DATA is published by the heartbeat, a client cannot follow every line
+    lastLine = data;
+    linesReceived++;
     
-    time(&rawtime);
-    timeinfo = localtime(&rawtime);
-    strftime(timestamp, sizeof(timestamp), "%H:%M:%S", timeinfo);
+    LOGF_DEBUG("Received data: %s", data.c_str());
+}
+
+void AMTEST01::publishHeartbeat()
+{
+    auto now = std::chrono::steady_clock::now();
+    double elapsed = std::chrono::duration<double>(now - lastHeartbeat).count();
+    double idle = std::chrono::duration<double>(now - lastData).count();
+    double rate = elapsed > 0 ? (linesReceived - linesReported) / elapsed : 0;
     
-    // Print to console
-    printf("[AMTEST01] [%s] DATA: %s\n", timestamp, data.c_str());
-    std::cout.flush();
+    if (capture.isOpen())
+        publishCaptureStats(elapsed);
+    if (probing)
+        publishProbeStats();
+    if (loadRunning)
+        publishLoadStats(elapsed);
+    if (DecoderS[0].s == ISS_ON && now - lastDecoderReport >= std::chrono::duration<double>(DecoderIntervalN[0].value))
+        publishDecoders();
     
-    // Update INDI property
-    IUSaveText(&StatusT[2], data.c_str());
+    char status[MAXINDILABEL];
+    if (idle >= IDLE_SECONDS)
+        snprintf(status, sizeof(status), "Reading Data, idle %.0f s", idle);
+    else
+        snprintf(status, sizeof(status), "Reading Data, %.0f lines/s", rate);
+    IUSaveText(&StatusT[1], status);
+    if (!lastLine.empty())
+        IUSaveText(&StatusT[2], lastLine.c_str());
     StatusTP.s = IPS_OK;
     IDSetText(&StatusTP, nullptr);
     
-    LOGF_INFO("Received data: %s", data.c_str());
+    linesReported = linesReceived;
+    lastHeartbeat = now;
+}
+
+bool AMTEST01::startCapture()
+{
+    uint64_t rotateBytes = static_cast<uint64_t>(CaptureRotateN[0].value) << 20;
+    if (!capture.open(CaptureFileT[0].text, CaptureFileT[1].text, rotateBytes))
+    {
+        LOGF_ERROR("Cannot start capture in %s: %s", CaptureFileT[0].text, strerror(errno));
+        return false;
+    }
+    
+    captureBytesReported = 0;
+    consoleLog.log(logLink, Astrometers::LogLevel::Info, "Capturing raw data to %s", capture.currentFile().c_str());
+    
+    // Nothing arrives to capture unless the port is being read
+    if (!isReading && startReading())
+    {
+        IUResetSwitch(&ReadDataSP);
+        ReadDataS[0].s = ISS_ON;
+        ReadDataSP.s = IPS_BUSY;
+        IDSetSwitch(&ReadDataSP, nullptr);
+    }
+    return true;
+}
+
+void AMTEST01::stopCapture()
+{
+    if (!capture.isOpen())
+        return;
+        
+    capture.close();
+    
+    RawCapture::Stats stats = capture.stats();
+    CaptureStatsN[0].value = 0;
+    CaptureStatsN[1].value = 0;
+    CaptureStatsN[2].value = stats.bytes;
+    CaptureStatsN[3].value = stats.files;
+    CaptureStatsN[4].value = stats.dropped;
+    CaptureStatsNP.s = stats.failed ? IPS_ALERT : IPS_OK;
+    IDSetNumber(&CaptureStatsNP, nullptr);
+    
+    IUResetSwitch(&CaptureSP);
+    CaptureS[1].s = ISS_ON;
+    CaptureSP.s = IPS_OK;
+    IDSetSwitch(&CaptureSP, nullptr);
+    
+    consoleLog.log(logLink, Astrometers::LogLevel::Info, "Capture stopped: %llu bytes in %u files, %llu dropped",
+                   static_cast<unsigned long long>(stats.bytes), stats.files,
+                   static_cast<unsigned long long>(stats.dropped));
+}
+
+void AMTEST01::publishCaptureStats(double elapsed)
+{
+    RawCapture::Stats stats = capture.stats();
+    
+    CaptureStatsN[0].value = elapsed > 0 ? (stats.bytes - captureBytesReported) / elapsed : 0;
+    CaptureStatsN[1].value = elapsed > 0 ? (linesReceived - linesReported) / elapsed : 0;
+    CaptureStatsN[2].value = stats.bytes;
+    CaptureStatsN[3].value = stats.files;
+    CaptureStatsN[4].value = stats.dropped;
+    
+    // Dropped bytes mean the disk does not keep up, a failed write ends the capture
+    if (stats.failed)
+        CaptureStatsNP.s = IPS_ALERT;
+    else
+        CaptureStatsNP.s = stats.dropped > 0 ? IPS_BUSY : IPS_OK;
+    IDSetNumber(&CaptureStatsNP, nullptr);
+    
+    captureBytesReported = stats.bytes;
+    
+    if (stats.failed)
+    {
+        LOGF_ERROR("Capture write to %s failed, capture stopped", capture.currentFile().c_str());
+        stopCapture();
+    }
+}
+
+bool AMTEST01::startProbe()
+{
+    bool echo = ProbeModeS[PROBE_ECHO].s == ISS_ON;
+    if (loadRunning)
+    {
+        LOG_ERROR("Stop the load generator before probing, both wait for the device's replies");
+        return false;
+    }
+    if (echo && ProbeCommandT[0].text[0] == '\0')
+    {
+        LOG_ERROR("Set the echo command before probing");
+        return false;
+    }
+    
+    // Replies are only answered while the port is read
+    if (!isReading)
+    {
+        if (!startReading())
+            return false;
+        IUResetSwitch(&ReadDataSP);
+        ReadDataS[0].s = ISS_ON;
+        ReadDataSP.s = IPS_BUSY;
+        IDSetSwitch(&ReadDataSP, nullptr);
+    }
+    
+    // Echo replies end with the device's frame terminator, loopback probes are lines.
+    // A partial line cut under the old terminator would not make sense under the new one.
+    lineTerminator = (echo && ProbeCommandT[1].text[0] != '\0') ? ProbeCommandT[1].text[0] : '\n';
+    ringHead = ringScan = ringTail;
+    discardingLine = false;
+    
+    probeLatency.reset();
+    probesSent = probesReceived = probesLost = probesStale = 0;
+    probeMin = UINT32_MAX;
+    probeMax = 0;
+    probeSum = probeSumSquares = 0;
+    probeJitter = 0;
+    probeInFlight = false;
+    probing = true;
+    
+    if (echo)
+        consoleLog.log(logLink, Astrometers::LogLevel::Info, "Probing latency with \"%s\" at %.1f/s",
+                       ProbeCommandT[0].text, ProbeSettingsN[0].value);
+    else
+        consoleLog.log(logLink, Astrometers::LogLevel::Info, "Probing loopback latency at %.1f/s",
+                       ProbeSettingsN[0].value);
+                       
+    nextProbeAt = probeQuietUntil = std::chrono::steady_clock::now();
+    sendProbe();
+    return true;
+}
+
+void AMTEST01::stopProbe()
+{
+    if (!probing)
+        return;
+        
+    probing = false;
+    if (probeTimerID >= 0)
+    {
+        IERmTimer(probeTimerID);
+        probeTimerID = -1;
+    }
+    
+    lineTerminator = '\n';
+    ringHead = ringScan = ringTail;
+    discardingLine = false;
+    
+    publishProbeStats();
+    IUResetSwitch(&ProbeSP);
+    ProbeS[1].s = ISS_ON;
+    ProbeSP.s = IPS_OK;
+    IDSetSwitch(&ProbeSP, nullptr);
+    
+    consoleLog.log(logLink, Astrometers::LogLevel::Info, "Probe stopped: %llu sent, %llu received, %llu lost, p50 %.3f ms, p99 %.3f ms",
+                   static_cast<unsigned long long>(probesSent), static_cast<unsigned long long>(probesReceived),
+                   static_cast<unsigned long long>(probesLost), probeLatency.percentile(50) / 1000.0,
+                   probeLatency.percentile(99) / 1000.0);
+}
+
+void AMTEST01::probeTimer(void *userpointer)
+{
+    AMTEST01 *driver = static_cast<AMTEST01 *>(userpointer);
+    driver->probeTimerID = -1;
+    driver->sendProbe();
+}
+
+void AMTEST01::sendProbe()
+{
+    using namespace std::chrono;
+    
+    if (!probing)
+        return;
+        
+    auto now = steady_clock::now();
+    
+    // An unanswered probe counts as lost once its timeout passes, until then no new one goes out
+    auto timeout = milliseconds(static_cast<int>(ProbeSettingsN[1].value));
+    bool echo = ProbeModeS[PROBE_ECHO].s == ISS_ON;
+    if (probeInFlight && now - probeSentAt >= timeout)
+    {
+        probeInFlight = false;
+        probesLost++;
+        
+        // An echo reply carries nothing to tell it apart, a late one would be
+        // credited to the next probe
+        if (echo)
+            probeQuietUntil = now + timeout;
+    }
+    
+    if (!probeInFlight && (!echo || now >= probeQuietUntil))
+    {
+        char probe[MAXRBUF];
+        uint32_t sentMicros = static_cast<uint32_t>(duration_cast<microseconds>(now.time_since_epoch()).count());
+        
+        if (echo)
+        {
+            snprintf(probe, sizeof(probe), "%s", ProbeCommandT[0].text);
+        }
+        else
+        {
+            // PROBE,<sequence>,<send time us>: the reply carries everything needed to time it
+            char sequence[9], stamp[9];
+            Astrometers::Proto::encodeHex(++probeSequence, 8, sequence, sizeof(sequence));
+            Astrometers::Proto::encodeHex(sentMicros, 8, stamp, sizeof(stamp));
+            sequence[8] = stamp[8] = '\0';
+            snprintf(probe, sizeof(probe), "PROBE,%s,%s\n", sequence, stamp);
+        }
+        
+        probeSentAt = now;
+        probeInFlight = true;
+        probesSent++;
+        
+        if (isSimulation())
+        {
+            // A 115200 baud link behind a full speed USB adapter: the probe on the
+            // wire both ways, a poll interval each way and the odd stalled frame
+            static std::mt19937 random(1);
+            std::uniform_int_distribution<uint32_t> frame(0, 999);
+            std::uniform_int_distribution<uint32_t> stall(0, 499);
+            uint32_t micros = 2 * strlen(probe) * 87 + frame(random) + frame(random);
+            if (stall(random) == 0)
+                micros += 5000 + frame(random) * 15;
+            probeInFlight = false;
+            recordProbe(micros);
+        }
+        else if (!sendCommand(probe))
+        {
+            probeInFlight = false;
+            stopProbe();
+            ProbeSP.s = IPS_ALERT;
+            IDSetSwitch(&ProbeSP, nullptr);
+            return;
+        }
+    }
+    
+    // Fixed rate schedule, a late tick does not shift the ones after it
+    nextProbeAt += duration_cast<steady_clock::duration>(duration<double>(1.0 / ProbeSettingsN[0].value));
+    if (nextProbeAt < now)
+        nextProbeAt = now;
+    auto delay = duration_cast<milliseconds>(nextProbeAt - steady_clock::now()).count();
+    probeTimerID = IEAddTimer(static_cast<int>(std::max<int64_t>(delay, 0)), probeTimer, this);
+}
+
+bool AMTEST01::handleProbeReply(const std::string &line)
+{
+    using namespace std::chrono;
+    
+    auto now = steady_clock::now();
+    
+    // Echo mode: every reply answers the probe in flight, if there is one
+    if (ProbeModeS[PROBE_ECHO].s == ISS_ON)
+    {
+        // Dropped, and the next probe waits until the link has been quiet for a timeout
+        if (!probeInFlight)
+        {
+            probesStale++;
+            probeQuietUntil = now + milliseconds(static_cast<int>(ProbeSettingsN[1].value));
+            return true;
+        }
+        probeInFlight = false;
+        recordProbe(static_cast<uint32_t>(duration_cast<microseconds>(now - probeSentAt).count()));
+        return true;
+    }
+    
+    // Loopback: only our own lines are probes, anything else is ordinary data
+    std::string_view fields[4];
+    uint32_t sequence = 0, sentMicros = 0;
+    if (Astrometers::Proto::splitFields(line, fields, 4) != 3 || fields[0] != "PROBE" ||
+            !Astrometers::Proto::decodeHex(fields[1], sequence) || !Astrometers::Proto::decodeHex(fields[2], sentMicros))
+        return false;
+        
+    // A probe that already timed out, or an echo of some earlier run
+    if (!probeInFlight || sequence != probeSequence)
+    {
+        probesStale++;
+        return true;
+    }
+    
+    probeInFlight = false;
+    
+    // Unsigned difference stays right across the 71 minute wrap of the stamp
+    uint32_t nowMicros = static_cast<uint32_t>(duration_cast<microseconds>(now.time_since_epoch()).count());
+    recordProbe(nowMicros - sentMicros);
+    return true;
+}
+
+void AMTEST01::recordProbe(uint32_t micros)
+{
+    probeLatency.record(micros);
+    probesReceived++;
+    probeMin = std::min(probeMin, micros);
+    probeMax = std::max(probeMax, micros);
+    probeSum += micros;
+    probeSumSquares += static_cast<double>(micros) * micros;
+    
+    if (probesReceived > 1)
+    {
+        double difference = std::fabs(static_cast<double>(micros) - lastProbeLatency);
+        probeJitter += (difference - probeJitter) / 16.0;
+    }
+    lastProbeLatency = micros;
+}
+
+void AMTEST01::publishProbeStats()
+{
+    double mean = probesReceived > 0 ? probeSum / probesReceived : 0;
+    double variance = probesReceived > 0 ? probeSumSquares / probesReceived - mean * mean : 0;
+    
+    ProbeStatsN[0].value = probesSent;
+    ProbeStatsN[1].value = probesReceived;
+    ProbeStatsN[2].value = probesLost;
+    ProbeStatsN[3].value = probesReceived > 0 ? probeMin / 1000.0 : 0;
+    ProbeStatsN[4].value = mean / 1000.0;
+    ProbeStatsN[5].value = probeLatency.percentile(50) / 1000.0;
+    ProbeStatsN[6].value = probeLatency.percentile(90) / 1000.0;
+    ProbeStatsN[7].value = probeLatency.percentile(99) / 1000.0;
+    ProbeStatsN[8].value = probeLatency.percentile(99.9) / 1000.0;
+    ProbeStatsN[9].value = probeMax / 1000.0;
+    ProbeStatsN[10].value = std::sqrt(std::max(variance, 0.0)) / 1000.0;
+    ProbeStatsN[11].value = probeJitter / 1000.0;
+    ProbeStatsNP.s = probesLost > 0 ? IPS_BUSY : IPS_OK;
+    IDSetNumber(&ProbeStatsNP, nullptr);
+}
+
+bool AMTEST01::exportProbeReport()
+{
+    if (probesSent == 0)
+    {
+        LOG_ERROR("No latency probe has run yet");
+        return false;
+    }
+    
+    // Reports go next to the captures
+    std::error_code error;
+    std::filesystem::create_directories(CaptureFileT[0].text, error);
+    
+    time_t now = time(nullptr);
+    struct tm local;
+    localtime_r(&now, &local);
+    char fileName[64], date[64];
+    strftime(fileName, sizeof(fileName), "/latency-%Y%m%d-%H%M%S.txt", &local);
+    strftime(date, sizeof(date), "%Y-%m-%d %H:%M:%S %Z", &local);
+    std::string path = std::string(CaptureFileT[0].text) + fileName;
+    
+    FILE *fp = fopen(path.c_str(), "w");
+    if (fp == nullptr)
+    {
+        LOGF_ERROR("Cannot write %s: %s", path.c_str(), strerror(errno));
+        return false;
+    }
+    
+    publishProbeStats();
+    
+    fprintf(fp, "# AMTEST01 serial round-trip latency\n");
+    fprintf(fp, "# date: %s\n", date);
+    fprintf(fp, "# port: %s%s\n", isSimulation() ? "simulated " : "", serialConnection->port());
+    if (ProbeModeS[PROBE_ECHO].s == ISS_ON)
+        fprintf(fp, "# mode: echo \"%s\", reply ends with \"%s\"\n", ProbeCommandT[0].text, ProbeCommandT[1].text);
+    else
+        fprintf(fp, "# mode: loopback\n");
+    fprintf(fp, "# rate: %.1f/s, timeout %.0f ms\n", ProbeSettingsN[0].value, ProbeSettingsN[1].value);
+    fprintf(fp, "\n");
+    
+    for (int i = 0; i < 12; i++)
+        fprintf(fp, i < 3 ? "%-10s %.0f\n" : "%-10s %.3f\n", ProbeStatsN[i].name, ProbeStatsN[i].value);
+    fprintf(fp, "%-10s %llu\n", "STALE", static_cast<unsigned long long>(probesStale));
+    fprintf(fp, "\n");
+    
+    // Bucket upper bound in ms, probes in the bucket, cumulative share
+    fprintf(fp, "# le_ms count cumulative_percent\n");
+    uint64_t total = probeLatency.count(), seen = 0;
+    for (int i = 0; i < LatencyHistogram::BUCKETS; i++)
+    {
+        uint64_t count = probeLatency.bucketCount(i);
+        seen += count;
+        fprintf(fp, "%10.3f %10llu %7.3f\n", LatencyHistogram::bucketUpperBound(i) / 1000.0,
+                static_cast<unsigned long long>(count), total > 0 ? 100.0 * seen / total : 0);
+    }
+    
+    fclose(fp);
+    LOGF_INFO("Latency report of %llu probes written to %s", static_cast<unsigned long long>(probesSent), path.c_str());
+    return true;
+}
+
+// Commands are separated by blanks or line breaks, "//" starts a comment and a
+// trailing "!" marks a command the device does not answer, e.g. ":FG#!".
+// "\n" in a command stands for a line break, for line based devices.
+bool AMTEST01::loadScript()
+{
+    std::string script = LoadScriptT[0].text;
+    if (LoadScriptT[1].text[0] != '\0')
+    {
+        std::ifstream file(LoadScriptT[1].text);
+        if (!file)
+        {
+            LOGF_ERROR("Cannot read load script %s: %s", LoadScriptT[1].text, strerror(errno));
+            return false;
+        }
+        script.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    }
+    
+    loadCommands.clear();
+    std::istringstream lines(script);
+    std::string line;
+    while (std::getline(lines, line))
+    {
+        size_t comment = line.find("//");
+        if (comment != std::string::npos)
+            line.erase(comment);
+            
+        std::istringstream tokens(line);
+        std::string token;
+        while (tokens >> token)
+        {
+            LoadCommand command;
+            command.expectsReply = token.back() != '!';
+            if (!command.expectsReply)
+                token.pop_back();
+                
+            for (size_t escape; (escape = token.find("\\n")) != std::string::npos;)
+                token.replace(escape, 2, "\n");
+                
+            if (token.empty())
+                continue;
+            command.frame = token;
+            loadCommands.push_back(command);
+        }
+    }
+    
+    if (loadCommands.empty())
+    {
+        LOG_ERROR("The load script has no commands");
+        return false;
+    }
+    return true;
+}
+
+bool AMTEST01::startLoad()
+{
+    if (probing)
+    {
+        LOG_ERROR("Stop the latency probe before loading the device, both wait for its replies");
+        return false;
+    }
+    
+    if (!loadScript())
+        return false;
+        
+    // Replies are only seen while the port is read
+    if (!isReading)
+    {
+        if (!startReading())
+            return false;
+        IUResetSwitch(&ReadDataSP);
+        ReadDataS[0].s = ISS_ON;
+        ReadDataSP.s = IPS_BUSY;
+        IDSetSwitch(&ReadDataSP, nullptr);
+    }
+    
+    lineTerminator = LoadScriptT[2].text[0] != '\0' ? LoadScriptT[2].text[0] : '\n';
+    ringHead = ringScan = ringTail;
+    discardingLine = false;
+    
+    loadNext = 0;
+    loadInFlight.clear();
+    loadLatency.reset();
+    loadSent = loadReplies = loadTimeouts = loadMalformed = loadLate = 0;
+    loadResyncing = false;
+    loadSentReported = loadRepliesReported = 0;
+    loadStarted = loadNextSend = simulatedDeviceFree = std::chrono::steady_clock::now();
+    loadRunning = true;
+    
+    consoleLog.log(logLink, Astrometers::LogLevel::Info, "Load generator started: %zu commands, %s, depth %.0f",
+                   loadCommands.size(), LoadSettingsN[0].value > 0 ? "paced" : "flat out", LoadSettingsN[1].value);
+                   
+    pumpLoad();
+    return true;
+}
+
+void AMTEST01::stopLoad()
+{
+    if (!loadRunning)
+        return;
+        
+    loadRunning = false;
+    if (loadTimerID >= 0)
+    {
+        IERmTimer(loadTimerID);
+        loadTimerID = -1;
+    }
+    
+    // Whatever is still in flight when the load stops has not timed out
+    loadInFlight.clear();
+    loadResyncing = false;
+    lineTerminator = '\n';
+    ringHead = ringScan = ringTail;
+    discardingLine = false;
+    
+    // Final figures are averages over the whole run
+    double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - loadStarted).count();
+    loadSentReported = loadRepliesReported = 0;
+    publishLoadStats(elapsed);
+    
+    IUResetSwitch(&LoadSP);
+    LoadS[1].s = ISS_ON;
+    LoadSP.s = IPS_OK;
+    IDSetSwitch(&LoadSP, nullptr);
+    
+    consoleLog.log(logLink, Astrometers::LogLevel::Info,
+                   "Load generator stopped: %llu sent, %llu replies, %llu timeouts, %llu malformed, %llu late, %.1f commands/s, %.1f replies/s",
+                   static_cast<unsigned long long>(loadSent), static_cast<unsigned long long>(loadReplies),
+                   static_cast<unsigned long long>(loadTimeouts), static_cast<unsigned long long>(loadMalformed),
+                   static_cast<unsigned long long>(loadLate), LoadStatsN[5].value, LoadStatsN[6].value);
+}
+
+void AMTEST01::loadTimer(void *userpointer)
+{
+    AMTEST01 *driver = static_cast<AMTEST01 *>(userpointer);
+    driver->loadTimerID = -1;
+    driver->pumpLoad();
+}
+
+void AMTEST01::pumpLoad()
+{
+    using namespace std::chrono;
+    
+    if (!loadRunning)
+        return;
+        
+    auto now = steady_clock::now();
+    
+    // The simulated firmware answers one command per service time, in order
+    if (isSimulation())
+    {
+        while (!loadInFlight.empty() && loadInFlight.front().simulatedReply <= now)
+            handleLoadReply("0000C350");
+    }
+    
+    // Replies come in request order, so only the oldest request can time out.
+    // Its reply may still come and would be paired with the next request, so
+    // everything in flight is given up and sending waits for a quiet link.
+    auto timeout = milliseconds(static_cast<int>(LoadSettingsN[2].value));
+    if (!loadInFlight.empty() && now - loadInFlight.front().sentAt >= timeout)
+    {
+        loadTimeouts += loadInFlight.size();
+        loadInFlight.clear();
+        loadResyncing = true;
+        loadLastReply = now;
+    }
+    if (loadResyncing && now - loadLastReply >= timeout)
+        loadResyncing = false;
+    
+    double rate = LoadSettingsN[0].value;
+    size_t depth = static_cast<size_t>(LoadSettingsN[1].value);
+    uint64_t count = static_cast<uint64_t>(LoadSettingsN[3].value);
+    auto period = duration_cast<steady_clock::duration>(duration<double>(rate > 0 ? 1.0 / rate : 0));
+    bool backlog = false;
+    
+    // A pass sends at most depth commands, commands without a reply never fill the pipeline
+    for (size_t burst = 0; !loadResyncing && burst < depth && loadInFlight.size() < depth && (count == 0 || loadSent < count);
+            burst++)
+    {
+        if (rate > 0 && now < loadNextSend)
+            break;
+            
+        // The wire is the limit: do not pile commands up in the driver's transmit queue
+        int queued = 0;
+        if (!isSimulation() && ioctl(PortFD, TIOCOUTQ, &queued) == 0 && queued > LOAD_TX_BACKLOG)
+        {
+            backlog = true;
+            break;
+        }
+        
+        const LoadCommand &command = loadCommands[loadNext];
+        loadNext = (loadNext + 1) % loadCommands.size();
+        
+        if (!sendCommand(command.frame.c_str()))
+        {
+            stopLoad();
+            LoadSP.s = IPS_ALERT;
+            IDSetSwitch(&LoadSP, nullptr);
+            return;
+        }
+        loadSent++;
+        
+        if (command.expectsReply)
+        {
+            LoadRequest request;
+            request.sentAt = now;
+            if (isSimulation())
+            {
+                simulatedDeviceFree = std::max(simulatedDeviceFree, now) + SIMULATED_SERVICE_TIME;
+                request.simulatedReply = simulatedDeviceFree;
+            }
+            loadInFlight.push_back(request);
+        }
+        
+        // RATE is a ceiling, time lost waiting for the pipeline is not made up later
+        if (rate > 0)
+        {
+            loadNextSend += period;
+            if (loadNextSend < now)
+                loadNextSend = now;
+        }
+    }
+    
+    // A fixed number of commands is done once the last reply is in or given up
+    if (count > 0 && loadSent >= count && loadInFlight.empty() && !loadResyncing)
+    {
+        stopLoad();
+        return;
+    }
+    
+    // Next wake up: a send slot, a timeout, a simulated reply or at least a look at timeouts
+    auto wake = now + LOAD_POLL;
+    bool canSend = !loadResyncing && loadInFlight.size() < depth && (count == 0 || loadSent < count);
+    if (loadResyncing)
+        wake = std::min(wake, loadLastReply + timeout);
+    else if (canSend && rate > 0)
+        wake = std::min(wake, loadNextSend);
+    else if (canSend)
+        wake = now + (backlog ? milliseconds(1) : milliseconds(0));
+    if (!loadInFlight.empty())
+    {
+        wake = std::min(wake, loadInFlight.front().sentAt + timeout);
+        if (isSimulation())
+            wake = std::min(wake, loadInFlight.front().simulatedReply);
+    }
+    
+    if (loadTimerID >= 0)
+        IERmTimer(loadTimerID);
+    auto delay = duration_cast<milliseconds>(wake - now).count();
+    loadTimerID = IEAddTimer(static_cast<int>(std::max<int64_t>(delay, 0)), loadTimer, this);
+}
+
+bool AMTEST01::handleLoadReply(const std::string &line)
+{
+    // A reply after its request timed out has nothing to match, it only
+    // pushes the end of the resync further out
+    if (loadResyncing || loadInFlight.empty())
+    {
+        loadLate++;
+        loadLastReply = std::chrono::steady_clock::now();
+        return true;
+    }
+    
+    auto sentAt = loadInFlight.front().sentAt;
+    loadInFlight.pop_front();
+    loadReplies++;
+    loadLatency.record(static_cast<uint32_t>(
+                           std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - sentAt).count()));
+                           
+    uint32_t value;
+    if (LoadReplyS[1].s == ISS_ON && !Astrometers::Proto::decodeHex(line, value))
+        loadMalformed++;
+    return true;
+}
+
+void AMTEST01::publishLoadStats(double elapsed)
+{
+    LoadStatsN[0].value = loadSent;
+    LoadStatsN[1].value = loadReplies;
+    LoadStatsN[2].value = loadTimeouts;
+    LoadStatsN[3].value = loadMalformed;
+    LoadStatsN[4].value = loadLate;
+    LoadStatsN[5].value = elapsed > 0 ? (loadSent - loadSentReported) / elapsed : 0;
+    LoadStatsN[6].value = elapsed > 0 ? (loadReplies - loadRepliesReported) / elapsed : 0;
+    LoadStatsN[7].value = loadLatency.percentile(50) / 1000.0;
+    LoadStatsN[8].value = loadLatency.percentile(99) / 1000.0;
+    
+    // Timeouts or garbage mean the firmware does not keep up at this load
+    LoadStatsNP.s = (loadTimeouts > 0 || loadMalformed > 0 || loadLate > 0) ? IPS_ALERT : IPS_OK;
+    IDSetNumber(&LoadStatsNP, nullptr);
+    
+    loadSentReported = loadSent;
+    loadRepliesReported = loadReplies;
+}
+
+void AMTEST01::addDecoder(ProtocolDecoder *decoder)
+{
+    DecoderChannel channel;
+    channel.decoder.reset(decoder);
+    channel.stats.reset(new MessageStats[decoder->typeCount()]);
+    channel.texts.reset(new IText[decoder->typeCount()]());
+    decoders.push_back(std::move(channel));
+}
+
+// arrival is the time of the read that completed the line, lines that came in
+// one read arrived together
+void AMTEST01::decodeLine(const std::string &line, std::chrono::steady_clock::time_point arrival)
+{
+    for (auto &channel : decoders)
+    {
+        decodedMessages.clear();
+        if (!channel.decoder->decode(line, decodedMessages))
+            continue;
+            
+        linesDecoded++;
+        for (const auto &message : decodedMessages)
+        {
+            MessageStats &stats = channel.stats[message.type];
+            stats.count++;
+            messagesDecoded++;
+            if (!message.valid)
+            {
+                stats.errors++;
+                messageErrors++;
+            }
+            
+            // Messages of one read arrived together, the interval is to the previous read
+            if (stats.seen && arrival != stats.last)
+            {
+                auto interval = std::chrono::duration_cast<std::chrono::microseconds>(arrival - stats.last).count();
+                uint32_t micros = static_cast<uint32_t>(std::min<int64_t>(interval, UINT32_MAX));
+                stats.intervals.record(micros);
+                stats.maxInterval = std::max(stats.maxInterval, micros);
+            }
+            stats.seen = true;
+            stats.last = arrival;
+        }
+        return;
+    }
+    
+    linesUnrecognized++;
+}
+
+void AMTEST01::resetDecoders()
+{
+    for (auto &channel : decoders)
+    {
+        for (int i = 0; i < channel.decoder->typeCount(); i++)
+        {
+            MessageStats &stats = channel.stats[i];
+            stats.count = stats.errors = stats.countReported = 0;
+            stats.seen = false;
+            stats.intervals.reset();
+            stats.maxInterval = 0;
+        }
+    }
+    linesDecoded = linesUnrecognized = messagesDecoded = messageErrors = 0;
+    lastDecoderReport = std::chrono::steady_clock::now();
+}
+
+void AMTEST01::publishDecoders()
+{
+    auto now = std::chrono::steady_clock::now();
+    double elapsed = std::chrono::duration<double>(now - lastDecoderReport).count();
+    
+    for (auto &channel : decoders)
+    {
+        for (int i = 0; i < channel.decoder->typeCount(); i++)
+        {
+            MessageStats &stats = channel.stats[i];
+            char text[MAXRBUF];
+            if (stats.count == 0)
+            {
+                snprintf(text, sizeof(text), "-");
+            }
+            else
+            {
+                // Interval percentiles are half-octave bucket bounds, max is exact
+                double rate = elapsed > 0 ? (stats.count - stats.countReported) / elapsed : 0;
+                snprintf(text, sizeof(text), "%llu, %.2f/s, %.1f%% err, interval p50 %.1f p99 %.1f max %.1f ms",
+                         static_cast<unsigned long long>(stats.count), rate, 100.0 * stats.errors / stats.count,
+                         stats.intervals.percentile(50) / 1000.0, stats.intervals.percentile(99) / 1000.0,
+                         stats.maxInterval / 1000.0);
+            }
+            IUSaveText(&channel.texts[i], text);
+            stats.countReported = stats.count;
+        }
+        channel.property.s = IPS_OK;
+        IDSetText(&channel.property, nullptr);
+    }
+    
+    DecoderSummaryN[0].value = linesDecoded;
+    DecoderSummaryN[1].value = linesUnrecognized;
+    DecoderSummaryN[2].value = messagesDecoded;
+    DecoderSummaryN[3].value = messagesDecoded > 0 ? 100.0 * messageErrors / messagesDecoded : 0;
+    DecoderSummaryNP.s = messageErrors > 0 ? IPS_BUSY : IPS_OK;
+    IDSetNumber(&DecoderSummaryNP, nullptr);
+    
+    lastDecoderReport = now;
 }
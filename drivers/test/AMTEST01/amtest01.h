@@ -8,9 +8,21 @@
 
 #pragma once
 
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <string>
+#include <vector>
+
 #include <libindi/defaultdevice.h>
 #include <libindi/connectionplugins/connectionserial.h>
 
+#include "asynclog.h"
+#include "latencyhistogram.h"
+#include "protocoldecoder.h"
+#include "rawcapture.h"
+
 namespace Connection
 {
     class Serial;
@@ -29,6 +41,9 @@ public:
 protected:
     virtual void TimerHit() override;
     virtual bool ISNewSwitch(const char *dev, const char *name, ISState *states, char *names[], int n) override;
+    virtual bool ISNewNumber(const char *dev, const char *name, double values[], char *names[], int n) override;
+    virtual bool ISNewText(const char *dev, const char *name, char *texts[], char *names[], int n) override;
+    virtual void debugTriggered(bool enable) override;
 
 private:
     // Serial connection
@@ -44,10 +59,204 @@ private:
     ISwitchVectorProperty ReadDataSP;
     ISwitch ReadDataS[2];
     
-    // Data reading
+    // Console log, written by a background thread
+    Astrometers::AsyncLog consoleLog{"[AMTEST01]"};
+    int logLink = -1;       // connection events
+    int logData = -1;       // received lines
+    INumberVectorProperty LogLevelsNP;
+    INumber LogLevelsN[2];
+
+    // Data reading, driven by the INDI event loop whenever the port is readable
+    bool startReading();
+    void stopReading();
+    static void portCallback(int fd, void *userpointer);
     bool readSerialData();
+    void processLines();
     void processData(const std::string& data);
+    void publishHeartbeat();
+    
+    // Received bytes wait here until their line is complete. Lines are taken
+    // out after every read, so it only ever holds a partial line plus one read.
+    static constexpr size_t RING_SIZE = 16384;      // power of two
+    static constexpr size_t READ_CHUNK_SIZE = 4096;
+    char ring[RING_SIZE];
+    size_t ringHead = 0;        // start of the pending line, counters run freely
+    size_t ringTail = 0;        // end of received data
+    size_t ringScan = 0;        // checked for newlines up to here
+    bool discardingLine = false;    // rest of an overlong line is being dropped
+    std::string lineBuffer;
+    std::string lastLine;
+    int portCallbackID = -1;
+    int portFlags = -1;         // restored when reading stops
+    
+    // Raw capture of the byte stream to disk
+    bool startCapture();
+    void stopCapture();
+    void publishCaptureStats(double elapsed);
+    
+    RawCapture capture;
+    uint64_t captureBytesReported = 0;
+    ITextVectorProperty CaptureFileTP;
+    IText CaptureFileT[2];
+    INumberVectorProperty CaptureRotateNP;
+    INumber CaptureRotateN[1];
+    ISwitchVectorProperty CaptureSP;
+    ISwitch CaptureS[2];
+    INumberVectorProperty CaptureStatsNP;
+    INumber CaptureStatsN[5];
+    
+    // Round-trip latency probe: a loopback line carrying its own send time, or
+    // a device command such as ":GP#" timed until its reply. One probe is in
+    // flight at a time, so the link is measured and not our own queueing.
+    enum ProbeMode
+    {
+        PROBE_LOOPBACK,
+        PROBE_ECHO
+    };
+    bool startProbe();
+    void stopProbe();
+    static void probeTimer(void *userpointer);
+    void sendProbe();
+    bool handleProbeReply(const std::string &line);
+    void recordProbe(uint32_t micros);
+    void publishProbeStats();
+    bool exportProbeReport();
+    
+    LatencyHistogram probeLatency;
+    bool probing = false;
+    bool probeInFlight = false;
+    uint32_t probeSequence = 0;
+    std::chrono::steady_clock::time_point probeSentAt;
+    std::chrono::steady_clock::time_point nextProbeAt;
+    std::chrono::steady_clock::time_point probeQuietUntil;   // echo mode: no probe before the link is quiet after a loss
+    int probeTimerID = -1;
+    uint64_t probesSent = 0;
+    uint64_t probesReceived = 0;
+    uint64_t probesLost = 0;
+    uint64_t probesStale = 0;   // replies arriving with no probe of theirs in flight
+    uint32_t probeMin = 0;
+    uint32_t probeMax = 0;
+    double probeSum = 0;
+    double probeSumSquares = 0;
+    double probeJitter = 0;     // RFC 3550 style, smoothed difference of consecutive latencies
+    uint32_t lastProbeLatency = 0;
+    char lineTerminator = '\n';
+    ISwitchVectorProperty ProbeModeSP;
+    ISwitch ProbeModeS[2];
+    ITextVectorProperty ProbeCommandTP;
+    IText ProbeCommandT[2];
+    INumberVectorProperty ProbeSettingsNP;
+    INumber ProbeSettingsN[2];
+    ISwitchVectorProperty ProbeSP;
+    ISwitch ProbeS[2];
+    ISwitchVectorProperty ProbeExportSP;
+    ISwitch ProbeExportS[1];
+    INumberVectorProperty ProbeStatsNP;
+    INumber ProbeStatsN[12];
+    
+    // Load generator: replays a command script against the device, paced or flat
+    // out, with up to a pipeline depth of requests waiting for their replies
+    struct LoadCommand
+    {
+        std::string frame;
+        bool expectsReply;
+    };
+    struct LoadRequest
+    {
+        std::chrono::steady_clock::time_point sentAt;
+        std::chrono::steady_clock::time_point simulatedReply;
+    };
+    bool loadScript();
+    bool startLoad();
+    void stopLoad();
+    static void loadTimer(void *userpointer);
+    void pumpLoad();
+    bool handleLoadReply(const std::string &line);
+    void publishLoadStats(double elapsed);
+    
+    static constexpr int LOAD_TX_BACKLOG = 256;     // bytes waiting in the driver before sending pauses
+    static constexpr std::chrono::milliseconds LOAD_POLL{10};
+    static constexpr std::chrono::microseconds SIMULATED_SERVICE_TIME{2000};
+    std::vector<LoadCommand> loadCommands;
+    size_t loadNext = 0;
+    std::deque<LoadRequest> loadInFlight;     // replies come back in request order
+    bool loadRunning = false;
+    int loadTimerID = -1;
+    std::chrono::steady_clock::time_point loadNextSend;
+    std::chrono::steady_clock::time_point loadStarted;
+    std::chrono::steady_clock::time_point simulatedDeviceFree;
+    bool loadResyncing = false;     // after a timeout: no sends until the link has been quiet for one timeout
+    std::chrono::steady_clock::time_point loadLastReply;
+    uint64_t loadSent = 0;
+    uint64_t loadReplies = 0;
+    uint64_t loadTimeouts = 0;
+    uint64_t loadMalformed = 0;     // replies that do not parse
+    uint64_t loadLate = 0;          // replies no request is waiting for, mostly after a timeout
+    uint64_t loadSentReported = 0;
+    uint64_t loadRepliesReported = 0;
+    LatencyHistogram loadLatency;
+    ITextVectorProperty LoadScriptTP;
+    IText LoadScriptT[3];
+    INumberVectorProperty LoadSettingsNP;
+    INumber LoadSettingsN[4];
+    ISwitchVectorProperty LoadReplySP;
+    ISwitch LoadReplyS[2];
+    ISwitchVectorProperty LoadSP;
+    ISwitch LoadS[2];
+    INumberVectorProperty LoadStatsNP;
+    INumber LoadStatsN[9];
+    
+    // Bus analyzer: every received line goes through the protocol decoders, their
+    // statistics are published at a fixed cadence rather than per line
+    struct MessageStats
+    {
+        uint64_t count = 0;
+        uint64_t errors = 0;
+        uint64_t countReported = 0;
+        bool seen = false;
+        std::chrono::steady_clock::time_point last;
+        LatencyHistogram intervals;     // us between arrivals
+        uint32_t maxInterval = 0;
+    };
+    struct DecoderChannel
+    {
+        std::unique_ptr<ProtocolDecoder> decoder;
+        std::unique_ptr<MessageStats[]> stats;
+        std::unique_ptr<IText[]> texts;
+        ITextVectorProperty property;
+        char propertyName[MAXINDINAME];
+    };
+    void addDecoder(ProtocolDecoder *decoder);
+    void decodeLine(const std::string &line, std::chrono::steady_clock::time_point arrival);
+    void resetDecoders();
+    void publishDecoders();
+    
+    std::vector<DecoderChannel> decoders;
+    std::vector<ProtocolDecoder::Message> decodedMessages;
+    uint64_t linesDecoded = 0;
+    uint64_t linesUnrecognized = 0;
+    uint64_t messagesDecoded = 0;
+    uint64_t messageErrors = 0;
+    std::chrono::steady_clock::time_point lastDecoderReport;
+    ISwitchVectorProperty DecoderSP;
+    ISwitch DecoderS[2];
+    INumberVectorProperty DecoderIntervalNP;
+    INumber DecoderIntervalN[1];
+    ISwitchVectorProperty DecoderResetSP;
+    ISwitch DecoderResetS[1];
+    INumberVectorProperty DecoderSummaryNP;
+    INumber DecoderSummaryN[4];
+    
+    // Idle heartbeat, the only timer left while reading a real port
+    static constexpr uint32_t HEARTBEAT_MS = 1000;
+    static constexpr uint32_t SIMULATION_MS = 100;
+    static constexpr double IDLE_SECONDS = 5;
+    int timerID = -1;
+    uint64_t linesReceived = 0;
+    uint64_t linesReported = 0;
+    uint64_t bytesDropped = 0;
+    std::chrono::steady_clock::time_point lastData;
+    std::chrono::steady_clock::time_point lastHeartbeat;
     
-    // Timer for continuous reading
     bool isReading{false};
 };
@@ -0,0 +1,134 @@
+/*
+    Protocol decoders for the AMTEST01 bus analyzer
+
+    Author: Roman Dvořák <info@astrometers.cz>
+    Copyright (C) 2025 Astrometers
+*/
+
+#include "protocoldecoder.h"
+#include "astrometers_proto.h"
+#include "skyschema.h"
+
+#include <cstdint>
+
+// Sentences of the schema, then "$" lines with a tag the schema does not know
+static constexpr int SKY_UNKNOWN = SkySchema::SENTENCE_COUNT;
+
+int SkySentenceDecoder::typeCount() const
+{
+    return SKY_UNKNOWN + 1;
+}
+
+const char *SkySentenceDecoder::typeName(int type) const
+{
+    return type < SKY_UNKNOWN ? SkySchema::SENTENCES[type].tag.data() : "unknown";
+}
+
+bool SkySentenceDecoder::decode(std::string_view line, std::vector<Message> &messages) const
+{
+    if (line.size() < 2 || line[0] != '$')
+        return false;
+
+    // Same parse as the AMSKY01 driver, so a sentence it would drop is an error here
+    std::string_view fields[SkySchema::MAX_FIELDS + 1];
+    size_t count = Astrometers::Proto::splitFields(line.substr(1), fields, SkySchema::MAX_FIELDS + 1);
+
+    int sentence = SkySchema::findSentence(fields[0]);
+    if (sentence < 0)
+    {
+        messages.push_back(Message{SKY_UNKNOWN, false});
+        return true;
+    }
+
+    double values[SkySchema::MAX_FIELDS];
+    double parameters[SkySchema::MAX_PARAMETERS];
+    messages.push_back(Message{sentence, SkySchema::PARSERS[sentence](fields, count, values, parameters)});
+    return true;
+}
+
+// Commands as sent by AMFOC01, with the width of their hex parameter
+static const struct
+{
+    const char *name;
+    int paramWidth;     // 0 for commands without one
+} FOCUSER_COMMANDS[] =
+{
+    { "GP", 0 }, { "GT", 0 }, { "SN", 5 }, { "SP", 5 }, { "FG", 0 }
+};
+
+static constexpr int FOCUSER_COMMAND_COUNT = sizeof(FOCUSER_COMMANDS) / sizeof(FOCUSER_COMMANDS[0]);
+static constexpr int FOCUSER_OTHER = FOCUSER_COMMAND_COUNT;     // ":..#" with an unknown command
+static constexpr int FOCUSER_REPLY = FOCUSER_COMMAND_COUNT + 1; // "<hex>#"
+
+int FocuserFrameDecoder::typeCount() const
+{
+    return FOCUSER_REPLY + 1;
+}
+
+const char *FocuserFrameDecoder::typeName(int type) const
+{
+    if (type < FOCUSER_COMMAND_COUNT)
+        return FOCUSER_COMMANDS[type].name;
+    return type == FOCUSER_OTHER ? "other" : "reply";
+}
+
+static bool isBlank(char c)
+{
+    return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+}
+
+bool FocuserFrameDecoder::decode(std::string_view line, std::vector<Message> &messages) const
+{
+    size_t first = messages.size();
+    size_t pos = 0;
+
+    while (true)
+    {
+        while (pos < line.size() && isBlank(line[pos]))
+            pos++;
+        if (pos == line.size())
+            break;
+
+        // An unterminated tail is a frame cut short, unless nothing here looked like a frame
+        size_t end = line.find('#', pos);
+        std::string_view frame = line.substr(pos, end == std::string_view::npos ? std::string_view::npos : end - pos);
+        bool terminated = end != std::string_view::npos;
+        uint32_t value;
+
+        if (!frame.empty() && frame[0] == ':')
+        {
+            std::string_view command = frame.substr(1, 2);
+            std::string_view param = frame.size() > 3 ? frame.substr(3) : std::string_view();
+
+            int type = FOCUSER_OTHER;
+            for (int i = 0; i < FOCUSER_COMMAND_COUNT; i++)
+            {
+                if (command == FOCUSER_COMMANDS[i].name)
+                    type = i;
+            }
+
+            bool valid = terminated && type != FOCUSER_OTHER;
+            if (valid && FOCUSER_COMMANDS[type].paramWidth > 0)
+                valid = param.size() == static_cast<size_t>(FOCUSER_COMMANDS[type].paramWidth) &&
+                        Astrometers::Proto::decodeHex(param, value);
+            else if (valid)
+                valid = param.empty();
+            messages.push_back(Message{type, valid});
+        }
+        else if (Astrometers::Proto::decodeHex(frame, value) || messages.size() > first)
+        {
+            messages.push_back(Message{FOCUSER_REPLY, terminated && Astrometers::Proto::decodeHex(frame, value)});
+        }
+        else
+        {
+            // Text with a '#' somewhere is not a focuser frame
+            return false;
+        }
+
+        if (!terminated)
+            break;
+        pos = end + 1;
+    }
+
+    return messages.size() > first;
+}
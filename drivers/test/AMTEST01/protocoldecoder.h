@@ -0,0 +1,66 @@
+/*
+    Protocol decoders for the AMTEST01 bus analyzer
+
+    A decoder recognizes the messages of one Astrometers protocol in a received
+    line and tells their type and whether they parse. The driver offers every
+    line to its decoders in turn and keeps the statistics, so supporting
+    another device is one more ProtocolDecoder subclass.
+
+    Author: Roman Dvořák <info@astrometers.cz>
+    Copyright (C) 2025 Astrometers
+*/
+
+#pragma once
+
+#include <string_view>
+#include <vector>
+
+class ProtocolDecoder
+{
+public:
+    struct Message
+    {
+        int type;       // index into the decoder's types
+        bool valid;     // false when the message is recognized but does not parse
+    };
+
+    virtual ~ProtocolDecoder() = default;
+
+    // Short name, used in property names
+    virtual const char *name() const = 0;
+
+    // Message types this decoder tells apart, fixed for its lifetime
+    virtual int typeCount() const = 0;
+    virtual const char *typeName(int type) const = 0;
+
+    // Appends the messages found in line to messages. Returns false if the
+    // line is not of this protocol, messages is left untouched then.
+    virtual bool decode(std::string_view line, std::vector<Message> &messages) const = 0;
+};
+
+// AMSKY01 sentences "$<tag>,<field>,...", checked against the sentence schema
+class SkySentenceDecoder : public ProtocolDecoder
+{
+public:
+    const char *name() const override
+    {
+        return "AMSKY01";
+    }
+    int typeCount() const override;
+    const char *typeName(int type) const override;
+    bool decode(std::string_view line, std::vector<Message> &messages) const override;
+};
+
+// AMFOC01 frames: ":<CMD><hex param>#" commands and "<hex>#" replies, any
+// number of them in one line
+class FocuserFrameDecoder : public ProtocolDecoder
+{
+public:
+    const char *name() const override
+    {
+        return "AMFOC01";
+    }
+    int typeCount() const override;
+    const char *typeName(int type) const override;
+    bool decode(std::string_view line, std::vector<Message> &messages) const override;
+};
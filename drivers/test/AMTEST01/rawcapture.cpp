@@ -0,0 +1,280 @@
+/*
+    Raw serial capture to disk
+
+    Author: Roman Dvořák <info@astrometers.cz>
+    Copyright (C) 2025 Astrometers
+*/
+
+#include "rawcapture.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <filesystem>
+#include <fcntl.h>
+#include <unistd.h>
+
+static const char CAPTURE_MAGIC[4] = { 'A', 'M', 'R', 'C' };
+static constexpr uint32_t CAPTURE_VERSION = 1;
+
+// How long the writer sleeps when the queue is empty, and how long a partly
+// filled buffer may wait before it goes to disk anyway
+static constexpr std::chrono::milliseconds IDLE_SLEEP(10);
+static constexpr std::chrono::milliseconds FLUSH_INTERVAL(1000);
+
+RawCapture::RawCapture()
+{
+}
+
+RawCapture::~RawCapture()
+{
+    close();
+}
+
+bool RawCapture::open(const std::string &dir, const std::string &name, uint64_t rotate)
+{
+    if (running)
+        return true;
+
+    directory = dir;
+    prefix = name;
+    rotateBytes = std::max<uint64_t>(rotate, WRITE_SIZE);
+
+    std::error_code error;
+    std::filesystem::create_directories(directory, error);
+    if (error)
+        return false;
+
+    if (buffer == nullptr && posix_memalign(reinterpret_cast<void **>(&buffer), 4096, WRITE_SIZE) != 0)
+    {
+        buffer = nullptr;
+        return false;
+    }
+
+    sequence = 0;
+    bytes = 0;
+    dropped = 0;
+    written = 0;
+    files = 0;
+    failed = false;
+
+    if (!openFile())
+        return false;
+
+    queue.clear();
+    running = true;
+    writer = std::thread(&RawCapture::writerLoop, this);
+    return true;
+}
+
+void RawCapture::close()
+{
+    running = false;
+    if (writer.joinable())
+        writer.join();
+
+    closeFile();
+    free(buffer);
+    buffer = nullptr;
+}
+
+bool RawCapture::append(const char *data, size_t length, int64_t timestamp)
+{
+    if (!running)
+        return false;
+
+    while (length > 0)
+    {
+        size_t part = std::min(length, CHUNK_SIZE);
+        Chunk *chunk = queue.claim();
+        if (chunk == nullptr)
+        {
+            dropped.fetch_add(length, std::memory_order_relaxed);
+            return false;
+        }
+
+        chunk->timestamp = timestamp;
+        chunk->length = part;
+        memcpy(chunk->data, data, part);
+        queue.publish();
+
+        bytes.fetch_add(part, std::memory_order_relaxed);
+        data += part;
+        length -= part;
+    }
+    return true;
+}
+
+RawCapture::Stats RawCapture::stats() const
+{
+    Stats stats;
+    stats.bytes = bytes.load(std::memory_order_relaxed);
+    stats.written = written.load(std::memory_order_relaxed);
+    stats.dropped = dropped.load(std::memory_order_relaxed);
+    stats.files = files.load(std::memory_order_relaxed);
+    stats.failed = failed.load(std::memory_order_relaxed);
+    return stats;
+}
+
+std::string RawCapture::currentFile() const
+{
+    std::lock_guard<std::mutex> lock(pathMutex);
+    return path;
+}
+
+void RawCapture::writerLoop()
+{
+    auto lastFlush = std::chrono::steady_clock::now();
+
+    while (running)
+    {
+        bool wrote = false;
+        while (Chunk *chunk = queue.front())
+        {
+            writeChunk(*chunk);
+            queue.release();
+            wrote = true;
+        }
+
+        // Full buffers are written as they fill, a quiet port still gets its
+        // tail on disk within FLUSH_INTERVAL
+        auto now = std::chrono::steady_clock::now();
+        if (buffered > 0 && now - lastFlush >= FLUSH_INTERVAL)
+        {
+            flush();
+            lastFlush = now;
+        }
+
+        if (!wrote)
+            std::this_thread::sleep_for(IDLE_SLEEP);
+    }
+
+    // Chunks queued before close() still get written
+    while (Chunk *chunk = queue.front())
+    {
+        writeChunk(*chunk);
+        queue.release();
+    }
+}
+
+void RawCapture::writeChunk(const Chunk &chunk)
+{
+    if (fd < 0 || failed)
+        return;
+
+    ChunkHeader header { chunk.timestamp, chunk.length };
+    uint64_t size = sizeof(header) + chunk.length;
+
+    // A chunk never straddles two files
+    if (fileOffset + size > rotateBytes)
+    {
+        closeFile();
+        if (!openFile())
+        {
+            failed = true;
+            return;
+        }
+    }
+
+    put(&header, sizeof(header));
+    put(chunk.data, chunk.length);
+}
+
+void RawCapture::put(const void *data, size_t length)
+{
+    const char *source = static_cast<const char *>(data);
+    while (length > 0)
+    {
+        size_t part = std::min(length, WRITE_SIZE - buffered);
+        memcpy(buffer + buffered, source, part);
+        buffered += part;
+        fileOffset += part;
+        source += part;
+        length -= part;
+
+        if (buffered == WRITE_SIZE && !flush())
+            return;
+    }
+}
+
+bool RawCapture::flush()
+{
+    size_t done = 0;
+    while (done < buffered)
+    {
+        ssize_t n = write(fd, buffer + done, buffered - done);
+        if (n < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            failed = true;
+            buffered = 0;
+            return false;
+        }
+        done += n;
+    }
+
+    written.fetch_add(buffered, std::memory_order_relaxed);
+    buffered = 0;
+    return true;
+}
+
+bool RawCapture::openFile()
+{
+    // <prefix>-YYYYmmdd-HHMMSS-NNN.amraw, UTC of the file start
+    time_t now = time(nullptr);
+    struct tm utc;
+    gmtime_r(&now, &utc);
+    char stamp[32];
+    strftime(stamp, sizeof(stamp), "%Y%m%d-%H%M%S", &utc);
+
+    char name[256];
+    snprintf(name, sizeof(name), "%s-%s-%03u.amraw", prefix.c_str(), stamp, sequence++);
+    std::string filePath = (std::filesystem::path(directory) / name).string();
+
+    fd = ::open(filePath.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0)
+        return false;
+
+    // Reserve the whole file up front so hours of capture do not fragment it.
+    // Not every filesystem supports it, the capture works without.
+    posix_fallocate(fd, 0, rotateBytes);
+
+    FileHeader header;
+    memcpy(header.magic, CAPTURE_MAGIC, sizeof(header.magic));
+    header.version = CAPTURE_VERSION;
+    header.wallClock = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                           std::chrono::system_clock::now().time_since_epoch()).count();
+    header.monotonic = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                           std::chrono::steady_clock::now().time_since_epoch()).count();
+    header.reserved = 0;
+
+    buffered = 0;
+    fileOffset = 0;
+    put(&header, sizeof(header));
+
+    {
+        std::lock_guard<std::mutex> lock(pathMutex);
+        path = filePath;
+    }
+    files.fetch_add(1, std::memory_order_relaxed);
+    return true;
+}
+
+void RawCapture::closeFile()
+{
+    if (fd < 0)
+        return;
+
+    flush();
+
+    // Give back the preallocated space that was not used
+    if (ftruncate(fd, fileOffset) != 0)
+        failed = true;
+    ::close(fd);
+    fd = -1;
+}
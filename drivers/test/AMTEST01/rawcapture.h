@@ -0,0 +1,113 @@
+/*
+    Raw serial capture to disk
+
+    The received byte stream is written as it came off the port, cut into the
+    chunks the driver read, each stamped with the monotonic time of its read.
+    Files are preallocated to the rotation size and filled with large writes
+    from a background thread, the ingest path only copies into a queue.
+
+    File layout, host byte order:
+        FileHeader
+        { int64 monotonic ns, uint32 length, length bytes } ...
+
+    Author: Roman Dvořák <info@astrometers.cz>
+    Copyright (C) 2025 Astrometers
+*/
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include "spscqueue.h"
+
+class RawCapture
+{
+public:
+    static constexpr size_t CHUNK_SIZE = 4096;
+
+    struct Stats
+    {
+        uint64_t bytes;         // accepted from the port
+        uint64_t written;       // on disk, including framing
+        uint64_t dropped;       // bytes the writer could not take in time
+        uint32_t files;
+        bool failed;            // a write failed, capture stopped writing
+    };
+
+    RawCapture();
+    ~RawCapture();
+
+    // Starts a new file in directory and the writer thread. Files are rotated
+    // when they would grow past rotateBytes.
+    bool open(const std::string &directory, const std::string &prefix, uint64_t rotateBytes);
+    void close();
+    bool isOpen() const
+    {
+        return running;
+    }
+
+    // Ingest path, timestamp in ns on the steady clock. Chunks longer than
+    // CHUNK_SIZE are split. Returns false if anything was dropped.
+    bool append(const char *data, size_t length, int64_t timestamp);
+
+    Stats stats() const;
+    std::string currentFile() const;
+
+private:
+    static constexpr size_t WRITE_SIZE = 1 << 20;      // multiple of the 4 kB block size
+
+    struct Chunk
+    {
+        int64_t timestamp;
+        uint32_t length;
+        char data[CHUNK_SIZE];
+    };
+
+    struct FileHeader
+    {
+        char magic[4];
+        uint32_t version;
+        int64_t wallClock;      // ns since the epoch ...
+        int64_t monotonic;      // ... at this steady clock time, maps chunk times to UTC
+        uint64_t reserved;
+    };
+
+    struct ChunkHeader
+    {
+        int64_t timestamp;
+        uint32_t length;
+    } __attribute__((packed));
+
+    void writerLoop();
+    void writeChunk(const Chunk &chunk);
+    void put(const void *data, size_t length);
+    bool flush();
+    bool openFile();
+    void closeFile();
+
+    std::string directory;
+    std::string prefix;
+    uint64_t rotateBytes = 0;
+
+    SPSCQueue<Chunk, 256> queue;
+    std::thread writer;
+    std::atomic<bool> running{false};
+    std::atomic<uint64_t> bytes{0};
+    std::atomic<uint64_t> dropped{0};
+    std::atomic<uint64_t> written{0};
+    std::atomic<uint32_t> files{0};
+    std::atomic<bool> failed{false};
+
+    // Writer thread only
+    int fd = -1;
+    uint32_t sequence = 0;
+    uint64_t fileOffset = 0;    // logical size, flushed plus buffered
+    char *buffer = nullptr;     // page aligned, WRITE_SIZE
+    size_t buffered = 0;
+    std::string path;           // also read by currentFile(), under pathMutex
+    mutable std::mutex pathMutex;
+};
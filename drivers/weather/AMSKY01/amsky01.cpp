@@ -13,25 +13,106 @@
 */
 
 #include "amsky01.h"
+#include "astrometers_proto.h"
 #include "indicom.h"
 #include "libindi/connectionplugins/connectionserial.h"
 #include <termios.h>
 
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
 #include <memory>
-#include <string>
-#include <vector>
-#include <sstream>
-#include <iostream>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
 
 static std::unique_ptr<AMSKY01> amsky01(new AMSKY01());
 
+// How often the ingestion statistics are refreshed (s)
+static constexpr double INGEST_STATS_PERIOD = 1.0;
+
+static const char *DIAGNOSTICS_TAB = "Diagnostics";
+static const char *HISTORY_TAB = "History";
+static const char *REPLAY_TAB = "Replay";
+
+// In max speed mode the replay thread wakes the main loop once per this many lines
+static constexpr int REPLAY_BATCH = 64;
+
+// Weather parameters of all sentences in registration order, see skyschema.h
+using SkySchema::PARAMETERS;
+
+// "Temperature (°C)"
+static std::string parameterLabel(const SkySchema::Parameter &parameter)
+{
+    return std::string(parameter.label) + " (" + parameter.unit + ")";
+}
+
+// How often the timer checks for held back values and the heartbeat (ms)
+static constexpr uint32_t PUBLISH_TICK = 100;
+
+// Fast path safety checks in SafetyCondition order: unsafe at or above the first
+// threshold, safe again at or below the second
+static constexpr struct
+{
+    const char *name;
+    const char *label;
+    int parameter;
+    double unsafe;
+    double safe;
+} SAFETY_RULES[] =
+{
+    { "CLOUD_COVER", "Cloud Cover (%)", SkySchema::parameterIndex("WEATHER_CLOUD_COVER"), 70, 60 },
+    { "HUMIDITY", "Humidity (%)", SkySchema::parameterIndex("WEATHER_HUMIDITY"), 90, 85 },
+};
+
+// Critical parameter driven by the fast path, 0 safe and 1 unsafe
+static const char *SAFETY_PARAMETER = "WEATHER_SAFETY";
+
+// Rolling aggregates in RollupMetric order, over windows in tier order
+static const char *ROLLUP_NAMES[][2] =
+{
+    { "SKY_TEMPERATURE", "Sky Temp" },
+    { "CLOUD_COVER", "Cloud Cover" },
+    { "SKY_BRIGHTNESS", "Sky Brightness" },
+    { "HUMIDITY", "Humidity" },
+};
+
+static const struct
+{
+    const char *name;
+    const char *label;
+    double span;    // s
+} ROLLUP_WINDOWS[] =
+{
+    { "1M", "1 min", 60 },
+    { "10M", "10 min", 600 },
+    { "1H", "1 h", 3600 },
+};
+
+static const char *ROLLUP_STATS[][2] = { { "MEAN", "mean" }, { "MIN", "min" }, { "MAX", "max" } };
+
+// How often the rolling aggregates are published (s)
+static constexpr double ROLLUP_PERIOD = 1.0;
+
 AMSKY01::AMSKY01()
 {
     setVersion(1, 0);
+    
+    // Per-sample console output is off unless asked for or INDI debug is on
+    logLink = consoleLog.addCategory("LINK", Astrometers::LogLevel::Info);
+    logData = consoleLog.addCategory("DATA", Astrometers::LogLevel::Warning);
+    logValues = consoleLog.addCategory("VALUES", Astrometers::LogLevel::Warning);
+    consoleLog.start();
 }
 
 AMSKY01::~AMSKY01()
 {
+    stopReplay();
+    stopReaderThread();
+    consoleLog.stop();
 }
 
 const char *AMSKY01::getDefaultName()
@@ -44,23 +125,15 @@ bool AMSKY01::initProperties()
     INDI::Weather::initProperties();
 
     // Add weather parameters podle AMSKY01 senzorů
-    addParameter("WEATHER_TEMPERATURE", "Temperature (°C)", -50, 80, 15);
-    addParameter("WEATHER_HUMIDITY", "Humidity (%)", 0, 100, 15);  
-    addParameter("WEATHER_DEW_POINT", "Dew Point (°C)", -50, 50, 15);
-    addParameter("WEATHER_LIGHT_LUX", "Light (lux)", 0, 100000, 15);
-    addParameter("WEATHER_SKY_BRIGHTNESS", "Sky Brightness (mag/arcsec²)", 10, 25, 15);
-    addParameter("WEATHER_CLOUD_COVER", "Cloud Cover (%)", 0, 100, 15);
-    addParameter("WEATHER_SKY_TEMPERATURE", "Sky Temperature Avg (°C)", -80, 50, 15);
-    
-    // Individuální teploty ze sky senzoru (5 thermopile segmentů)
-    addParameter("WEATHER_SKY_TEMP_1", "Sky Temp 1 (°C)", -80, 50, 15);
-    addParameter("WEATHER_SKY_TEMP_2", "Sky Temp 2 (°C)", -80, 50, 15);
-    addParameter("WEATHER_SKY_TEMP_3", "Sky Temp 3 (°C)", -80, 50, 15);
-    addParameter("WEATHER_SKY_TEMP_4", "Sky Temp 4 (°C)", -80, 50, 15);
-    addParameter("WEATHER_SKY_TEMP_5", "Sky Temp 5 - Zenith (°C)", -80, 50, 15);
-    
+    for (const auto &parameter : PARAMETERS)
+        addParameter(parameter.name, parameterLabel(parameter), parameter.minOk, parameter.maxOk, 15);
+
+    // Not part of PARAMETERS, it is no reading and stays out of the history
+    addParameter(SAFETY_PARAMETER, "Safety Fast Path", 0, 0, 0);
+
     setCriticalParameter("WEATHER_TEMPERATURE");
     setCriticalParameter("WEATHER_HUMIDITY");
+    setCriticalParameter(SAFETY_PARAMETER);
 
     // Device info
     addDebugControl();
@@ -71,6 +144,136 @@ bool AMSKY01::initProperties()
     IUFillText(&StatusT[0], "DEVICE", "Device", "AMSKY01");
     IUFillText(&StatusT[1], "STATUS", "Status", "Disconnected");
     IUFillTextVector(&StatusTP, StatusT, 2, getDeviceName(), "DEVICE_STATUS", "Device Status", MAIN_CONTROL_TAB, IP_RO, 60, IPS_IDLE);
+    
+    // Ingestion statistics, superseded samples were replaced by a newer one before publishing
+    IUFillNumber(&IngestStatsN[0], "LINES", "Lines", "%.f", 0, 1e12, 0, 0);
+    IUFillNumber(&IngestStatsN[1], "SUPERSEDED", "Superseded", "%.f", 0, 1e12, 0, 0);
+    IUFillNumber(&IngestStatsN[2], "PARSE_ERRORS", "Parse Errors", "%.f", 0, 1e12, 0, 0);
+    IUFillNumber(&IngestStatsN[3], "DROPPED", "Dropped", "%.f", 0, 1e12, 0, 0);
+    IUFillNumberVector(&IngestStatsNP, IngestStatsN, 4, getDeviceName(), "INGEST_STATISTICS", "Ingestion",
+                       DIAGNOSTICS_TAB, IP_RO, 60, IPS_IDLE);
+    
+    // Reading history on disk
+    const char *home = getenv("HOME");
+    std::string historyDir = std::string(home != nullptr ? home : "/tmp") + "/.indi/AMSKY01/history";
+    IUFillText(&HistoryDirT[0], "DIRECTORY", "Directory", historyDir.c_str());
+    IUFillTextVector(&HistoryDirTP, HistoryDirT, 1, getDeviceName(), "HISTORY_DIRECTORY", "Store",
+                     HISTORY_TAB, IP_RW, 60, IPS_IDLE);
+    
+    // Off until the user asks for it, segments are preallocated and SD cards wear
+    IUFillSwitch(&HistoryRecordS[0], "ENABLE", "Enable", ISS_OFF);
+    IUFillSwitch(&HistoryRecordS[1], "DISABLE", "Disable", ISS_ON);
+    IUFillSwitchVector(&HistoryRecordSP, HistoryRecordS, 2, getDeviceName(), "HISTORY_RECORDING", "Recording",
+                       HISTORY_TAB, IP_RW, ISR_1OFMANY, 60, IPS_IDLE);
+    
+    IUFillNumber(&HistoryStatsN[0], "RECORDS", "Records", "%.f", 0, 1e12, 0, 0);
+    IUFillNumber(&HistoryStatsN[1], "SEGMENTS", "Segments", "%.f", 0, 1e9, 0, 0);
+    IUFillNumber(&HistoryStatsN[2], "BYTES_PER_RECORD", "Bytes/Record", "%.2f", 0, 1e6, 0, 0);
+    IUFillNumber(&HistoryStatsN[3], "DROPPED", "Dropped", "%.f", 0, 1e12, 0, 0);
+    IUFillNumberVector(&HistoryStatsNP, HistoryStatsN, 4, getDeviceName(), "HISTORY_STATISTICS", "Statistics",
+                       HISTORY_TAB, IP_RO, 60, IPS_IDLE);
+    
+    IUFillNumber(&HistoryExportN[0], "HOURS", "Last hours", "%.1f", 0.1, 24 * 365, 1, 8);
+    IUFillNumberVector(&HistoryExportNP, HistoryExportN, 1, getDeviceName(), "HISTORY_EXPORT", "Export CSV",
+                       HISTORY_TAB, IP_RW, 60, IPS_IDLE);
+    
+    // Light sensor ranging advice, the device keeps its own range until the
+    // firmware can be told another one
+    IUFillNumber(&LightWindowN[0], "LOW", "Low counts", "%.f", 0, 65535, 100, 2000);
+    IUFillNumber(&LightWindowN[1], "HIGH", "High counts", "%.f", 0, 65535, 100, 40000);
+    IUFillNumberVector(&LightWindowNP, LightWindowN, 2, getDeviceName(), "LIGHT_COUNT_WINDOW", "Light Count Window",
+                       OPTIONS_TAB, IP_RW, 60, IPS_IDLE);
+    
+    IUFillNumber(&LightRangingN[0], "GAIN", "Gain", "%.f", 0, 1e6, 0, 0);
+    IUFillNumber(&LightRangingN[1], "INTEGRATION_TIME", "Integration (ms)", "%.f", 0, 1e6, 0, 0);
+    IUFillNumber(&LightRangingN[2], "SAMPLES_PER_MINUTE", "Samples/min", "%.1f", 0, 1e6, 0, 0);
+    IUFillNumber(&LightRangingN[3], "ADVISED_GAIN", "Advised gain", "%.f", 0, 1e6, 0, 0);
+    IUFillNumber(&LightRangingN[4], "ADVISED_INTEGRATION_TIME", "Advised integration (ms)", "%.f", 0, 1e6, 0, 0);
+    IUFillNumberVector(&LightRangingNP, LightRangingN, 5, getDeviceName(), "LIGHT_RANGING_STATE", "Light Sensor",
+                       DIAGNOSTICS_TAB, IP_RO, 60, IPS_IDLE);
+    
+    // Safety fast path thresholds and state
+    for (int i = 0; i < SAFETY_CONDITIONS; i++)
+    {
+        char name[MAXINDINAME], label[MAXINDILABEL];
+        snprintf(name, sizeof(name), "%s_UNSAFE", SAFETY_RULES[i].name);
+        snprintf(label, sizeof(label), "%s unsafe at", SAFETY_RULES[i].label);
+        IUFillNumber(&SafetyThresholdsN[2 * i], name, label, "%.1f", 0, 100, 1, SAFETY_RULES[i].unsafe);
+        snprintf(name, sizeof(name), "%s_SAFE", SAFETY_RULES[i].name);
+        snprintf(label, sizeof(label), "%s safe at", SAFETY_RULES[i].label);
+        IUFillNumber(&SafetyThresholdsN[2 * i + 1], name, label, "%.1f", 0, 100, 1, SAFETY_RULES[i].safe);
+        IUFillLight(&SafetyL[i], SAFETY_RULES[i].name, SAFETY_RULES[i].label, IPS_IDLE);
+    }
+    IUFillNumber(&SafetyThresholdsN[2 * SAFETY_CONDITIONS], "PERSISTENCE", "Persistence (samples)", "%.f", 1, 100, 1, 3);
+    IUFillNumberVector(&SafetyThresholdsNP, SafetyThresholdsN, 2 * SAFETY_CONDITIONS + 1, getDeviceName(),
+                       "SAFETY_THRESHOLDS", "Safety Fast Path", OPTIONS_TAB, IP_RW, 60, IPS_IDLE);
+    IUFillLightVector(&SafetyLP, SafetyL, SAFETY_CONDITIONS, getDeviceName(), "SAFETY_FAST_PATH", "Safety Fast Path",
+                      MAIN_CONTROL_TAB, IPS_IDLE);
+    
+    // Rolling aggregates, mean/min/max per metric and window
+    for (int metric = 0; metric < ROLLUP_METRICS; metric++)
+    {
+        for (int tier = 0; tier < ROLLUP_TIERS; tier++)
+        {
+            for (int stat = 0; stat < 3; stat++)
+            {
+                char name[MAXINDINAME], label[MAXINDILABEL];
+                snprintf(name, sizeof(name), "%s_%s_%s", ROLLUP_NAMES[metric][0], ROLLUP_WINDOWS[tier].name, ROLLUP_STATS[stat][0]);
+                snprintf(label, sizeof(label), "%s %s %s", ROLLUP_NAMES[metric][1], ROLLUP_WINDOWS[tier].label, ROLLUP_STATS[stat][1]);
+                IUFillNumber(&RollupsN[(metric * ROLLUP_TIERS + tier) * 3 + stat], name, label, "%.2f", -1e6, 1e6, 0, 0);
+            }
+        }
+    }
+    IUFillNumberVector(&RollupsNP, RollupsN, ROLLUP_METRICS * ROLLUP_TIERS * 3, getDeviceName(), "SKY_ROLLUPS",
+                       "Rolling Aggregates", HISTORY_TAB, IP_RO, 60, IPS_IDLE);
+    
+    // Replay of a captured serial log, simulation mode only
+    IUFillText(&ReplayFileT[0], "FILE", "File", "");
+    IUFillTextVector(&ReplayFileTP, ReplayFileT, 1, getDeviceName(), "REPLAY_FILE", "Serial Log",
+                     REPLAY_TAB, IP_RW, 60, IPS_IDLE);
+    
+    IUFillNumber(&ReplaySpeedN[0], "SPEED", "Speed (x, 0 = max)", "%.1f", 0, 10000, 1, 1);
+    IUFillNumberVector(&ReplaySpeedNP, ReplaySpeedN, 1, getDeviceName(), "REPLAY_SPEED", "Playback",
+                       REPLAY_TAB, IP_RW, 60, IPS_IDLE);
+    
+    IUFillSwitch(&ReplayS[0], "START", "Start", ISS_OFF);
+    IUFillSwitch(&ReplayS[1], "STOP", "Stop", ISS_ON);
+    IUFillSwitchVector(&ReplaySP, ReplayS, 2, getDeviceName(), "REPLAY_CONTROL", "Replay",
+                       REPLAY_TAB, IP_RW, ISR_1OFMANY, 60, IPS_IDLE);
+    
+    IUFillNumber(&ReplayStatsN[0], "SENTENCES", "Sentences", "%.f", 0, 1e12, 0, 0);
+    IUFillNumber(&ReplayStatsN[1], "RATE", "Sentences/s", "%.1f", 0, 1e9, 0, 0);
+    IUFillNumber(&ReplayStatsN[2], "LATENCY_MEAN", "Latency Mean (ms)", "%.3f", 0, 1e6, 0, 0);
+    IUFillNumber(&ReplayStatsN[3], "LATENCY_MAX", "Latency Max (ms)", "%.3f", 0, 1e6, 0, 0);
+    IUFillNumberVector(&ReplayStatsNP, ReplayStatsN, 4, getDeviceName(), "REPLAY_STATISTICS", "Statistics",
+                       REPLAY_TAB, IP_RO, 60, IPS_IDLE);
+    
+    // Console log levels: 0 off, 1 error, 2 warning, 3 info, 4 debug
+    int logCategories[] = { logLink, logData, logValues };
+    for (int i = 0; i < 3; i++)
+    {
+        const char *category = consoleLog.categoryName(logCategories[i]);
+        IUFillNumber(&LogLevelsN[i], category, category, "%.f", 0, 4, 1,
+                     static_cast<double>(consoleLog.level(logCategories[i])));
+    }
+    IUFillNumberVector(&LogLevelsNP, LogLevelsN, 3, getDeviceName(), "CONSOLE_LOG_LEVELS",
+                       "Console Log (0 off - 4 debug)", OPTIONS_TAB, IP_RW, 60, IPS_IDLE);
+
+    // Publish filter, changes smaller than the deadband or faster than the interval stay off the wire
+    for (int i = 0; i < PARAM_COUNT; i++)
+    {
+        std::string label = parameterLabel(PARAMETERS[i]);
+        IUFillNumber(&PublishDeadbandN[i], PARAMETERS[i].name, label.c_str(), "%.3f", 0, 10000, 0, PARAMETERS[i].deadband);
+        IUFillNumber(&PublishIntervalN[i], PARAMETERS[i].name, label.c_str(), "%.f", 0, 3600000, 100, PARAMETERS[i].interval);
+    }
+    IUFillNumberVector(&PublishDeadbandNP, PublishDeadbandN, PARAM_COUNT, getDeviceName(), "PUBLISH_DEADBAND",
+                       "Publish Deadband", OPTIONS_TAB, IP_RW, 60, IPS_IDLE);
+    IUFillNumberVector(&PublishIntervalNP, PublishIntervalN, PARAM_COUNT, getDeviceName(), "PUBLISH_INTERVAL",
+                       "Publish Interval (ms)", OPTIONS_TAB, IP_RW, 60, IPS_IDLE);
+    
+    IUFillNumber(&PublishHeartbeatN[0], "HEARTBEAT", "Heartbeat (s)", "%.f", 1, 3600, 1, 60);
+    IUFillNumberVector(&PublishHeartbeatNP, PublishHeartbeatN, 1, getDeviceName(), "PUBLISH_HEARTBEAT",
+                       "Publish Heartbeat", OPTIONS_TAB, IP_RW, 60, IPS_IDLE);
 
     // Add standard controls
     addAuxControls();
@@ -86,25 +289,76 @@ bool AMSKY01::updateProperties()
     {
         // Add properties when connected
         defineProperty(&StatusTP);
-        
+        defineProperty(&SafetyLP);
+        defineProperty(&SafetyThresholdsNP);
+        defineProperty(&LightWindowNP);
+        defineProperty(&LightRangingNP);
+        defineProperty(&IngestStatsNP);
+        defineProperty(&PublishDeadbandNP);
+        defineProperty(&PublishIntervalNP);
+        defineProperty(&PublishHeartbeatNP);
+        defineProperty(&LogLevelsNP);
+        defineProperty(&HistoryDirTP);
+        defineProperty(&HistoryRecordSP);
+        defineProperty(&HistoryStatsNP);
+        defineProperty(&HistoryExportNP);
+        defineProperty(&RollupsNP);
+        defineProperty(&ReplayFileTP);
+        defineProperty(&ReplaySpeedNP);
+        defineProperty(&ReplaySP);
+        defineProperty(&ReplayStatsNP);
+        resetIngestStats();
+        resetPublishState();
+        resetRollups();
+        resetSafety();
+        lightAdvice = {0, 0};
+        lastLightReport = std::chrono::steady_clock::now();
+        lightSamplesReported = lightSamples;
+
         // Update status and start automatic data reading
         IUSaveText(&StatusT[1], "Connected - Auto Reading");
         StatusTP.s = IPS_OK;
         IDSetText(&StatusTP, nullptr);
         
-        printf("[AMSKY01] Device connected - starting automatic data reading\n");
-        std::cout.flush();
+        consoleLog.log(logLink, Astrometers::LogLevel::Info, "Device connected - starting automatic data reading");
+
+        // Lines from the device are read by a dedicated thread, the timer drives the
+        // simulator and the publish filter
+        if (!isSimulation() && !startReaderThread())
+            LOG_ERROR("Failed to start serial reader thread");
+        SetTimer(PUBLISH_TICK);
         
-        // Start continuous data reading
-        SetTimer(100); // Read every 100ms
+        if (HistoryRecordS[0].s == ISS_ON)
+            startHistory();
     }
     else
     {
+        stopReplay();
+        stopReaderThread();
+        stopHistory();
+        
         // Remove properties when disconnected
         deleteProperty(StatusTP.name);
-        
-        printf("[AMSKY01] Device disconnected\n");
-        std::cout.flush();
+        deleteProperty(SafetyLP.name);
+        deleteProperty(SafetyThresholdsNP.name);
+        deleteProperty(LightWindowNP.name);
+        deleteProperty(LightRangingNP.name);
+        deleteProperty(IngestStatsNP.name);
+        deleteProperty(PublishDeadbandNP.name);
+        deleteProperty(PublishIntervalNP.name);
+        deleteProperty(PublishHeartbeatNP.name);
+        deleteProperty(LogLevelsNP.name);
+        deleteProperty(HistoryDirTP.name);
+        deleteProperty(HistoryRecordSP.name);
+        deleteProperty(HistoryStatsNP.name);
+        deleteProperty(HistoryExportNP.name);
+        deleteProperty(RollupsNP.name);
+        deleteProperty(ReplayFileTP.name);
+        deleteProperty(ReplaySpeedNP.name);
+        deleteProperty(ReplaySP.name);
+        deleteProperty(ReplayStatsNP.name);
+
+        consoleLog.log(logLink, Astrometers::LogLevel::Info, "Device disconnected");
     }
 
     return true;
@@ -115,365 +369,1283 @@ bool AMSKY01::Handshake()
     if (isSimulation())
     {
         LOGF_INFO("Connected successfully to simulated %s.", getDeviceName());
-        printf("[AMSKY01] Connected to simulated device\n");
-        std::cout.flush();
+        consoleLog.log(logLink, Astrometers::LogLevel::Info, "Connected to simulated device");
         return true;
     }
 
     // Weather base class handles connection management
     // Just confirm connection is ready
     LOGF_INFO("Connected successfully to %s.", getDeviceName());
-    printf("[AMSKY01] Connected to serial device\n");
-    std::cout.flush();
-    
+    consoleLog.log(logLink, Astrometers::LogLevel::Info, "Connected to serial device");
+
     return true;
 }
 
 bool AMSKY01::sendCommand(const char *cmd)
 {
-    int nbytes_read = 0, nbytes_written = 0, tty_rc = 0;
-    char res[256] = {0};
+    int nbytes_written = 0, tty_rc = 0;
     LOGF_DEBUG("CMD <%s>", cmd);
 
-    if (!isSimulation())
-    {
-        tcflush(PortFD, TCIOFLUSH);
-        if ((tty_rc = tty_write_string(PortFD, cmd, &nbytes_written)) != TTY_OK)
-        {
-            char errorMessage[MAXRBUF];
-            tty_error_msg(tty_rc, errorMessage, MAXRBUF);
-            LOGF_ERROR("Serial write error: %s", errorMessage);
-            printf("[AMSKY01] Serial write error: %s\n", errorMessage);
-            std::cout.flush();
-            return false;
-        }
-    }
-
     if (isSimulation())
+        return true;
+        
+    // Write only: the reader thread owns the read side of the port, anything
+    // the device answers arrives there as a line like any other
+    if ((tty_rc = tty_write_string(PortFD, cmd, &nbytes_written)) != TTY_OK)
     {
-        strncpy(res, "OK#", 8);
-        nbytes_read = 3;
-    }
-    else
-    {
-        if ((tty_rc = tty_read_section(PortFD, res, '#', 1, &nbytes_read)) != TTY_OK)
-        {
-            char errorMessage[MAXRBUF];
-            tty_error_msg(tty_rc, errorMessage, MAXRBUF);
-            LOGF_ERROR("Serial read error: %s", errorMessage);
-            // Don't print error for timeout - normal for continuous reading
-            return false;
-        }
+        char errorMessage[MAXRBUF];
+        tty_error_msg(tty_rc, errorMessage, MAXRBUF);
+        LOGF_ERROR("Serial write error: %s", errorMessage);
+        return false;
     }
 
-    res[nbytes_read - 1] = '\0';
-    LOGF_DEBUG("RES <%s>", res);
-
     return true;
 }
 
-bool AMSKY01::ISNewSwitch(const char *dev, const char *name, ISState *states, char *names[], int n)
+bool AMSKY01::Disconnect()
 {
-    return INDI::Weather::ISNewSwitch(dev, name, states, names, n);
+    // The reader thread must let go of the port before it is closed
+    stopReplay();
+    stopReaderThread();
+    return INDI::Weather::Disconnect();
 }
 
-void AMSKY01::TimerHit()
+bool AMSKY01::ISNewSwitch(const char *dev, const char *name, ISState *states, char *names[], int n)
 {
-    if (isConnected())
+    if (dev != nullptr && strcmp(dev, getDeviceName()) == 0)
     {
-        readSerialData();
-        SetTimer(100); // Continue reading every 100ms
+        // History recording on/off
+        if (!strcmp(name, HistoryRecordSP.name))
+        {
+            IUUpdateSwitch(&HistoryRecordSP, states, names, n);
+            
+            bool ok = true;
+            if (HistoryRecordS[0].s == ISS_ON)
+                ok = startHistory();
+            else
+                stopHistory();
+                
+            HistoryRecordSP.s = ok ? IPS_OK : IPS_ALERT;
+            IDSetSwitch(&HistoryRecordSP, nullptr);
+            return true;
+        }
+        
+        // Replay start/stop, a finished replay flips back to stop by itself
+        if (!strcmp(name, ReplaySP.name))
+        {
+            IUUpdateSwitch(&ReplaySP, states, names, n);
+            
+            if (ReplayS[0].s == ISS_ON)
+            {
+                if (replayActive || startReplay())
+                {
+                    ReplaySP.s = IPS_BUSY;
+                }
+                else
+                {
+                    IUResetSwitch(&ReplaySP);
+                    ReplayS[1].s = ISS_ON;
+                    ReplaySP.s = IPS_ALERT;
+                }
+                IDSetSwitch(&ReplaySP, nullptr);
+            }
+            else if (replayActive)
+            {
+                finishReplay();
+            }
+            else
+            {
+                ReplaySP.s = IPS_IDLE;
+                IDSetSwitch(&ReplaySP, nullptr);
+            }
+            return true;
+        }
     }
+    
+    return INDI::Weather::ISNewSwitch(dev, name, states, names, n);
 }
 
-bool AMSKY01::readSerialData()
+bool AMSKY01::ISNewText(const char *dev, const char *name, char *texts[], char *names[], int n)
 {
-    // Use PortFD from base Weather class
-    if (PortFD < 0)
+    if (dev != nullptr && strcmp(dev, getDeviceName()) == 0)
     {
-        return false;
+        // History directory, recording moves over right away
+        if (!strcmp(name, HistoryDirTP.name))
+        {
+            IUUpdateText(&HistoryDirTP, texts, names, n);
+            
+            bool ok = true;
+            if (historyStore.isOpen())
+            {
+                stopHistory();
+                ok = startHistory();
+            }
+            
+            HistoryDirTP.s = ok ? IPS_OK : IPS_ALERT;
+            IDSetText(&HistoryDirTP, nullptr);
+            return true;
+        }
+        
+        // Replay file, used by the next start
+        if (!strcmp(name, ReplayFileTP.name))
+        {
+            IUUpdateText(&ReplayFileTP, texts, names, n);
+            ReplayFileTP.s = IPS_OK;
+            IDSetText(&ReplayFileTP, nullptr);
+            return true;
+        }
     }
-
-    char buffer[1024] = {0};
-    int nbytes_read = 0;
     
-    if (isSimulation())
+    return INDI::Weather::ISNewText(dev, name, texts, names, n);
+}
+
+bool AMSKY01::ISNewNumber(const char *dev, const char *name, double values[], char *names[], int n)
+{
+    if (dev != nullptr && strcmp(dev, getDeviceName()) == 0)
     {
-        // Generate realistic AMSKY01 test data
-        static int counter = 0;
-        counter++;
+        // Console log levels
+        if (!strcmp(name, LogLevelsNP.name))
+        {
+            IUUpdateNumber(&LogLevelsNP, values, names, n);
+            int logCategories[] = { logLink, logData, logValues };
+            for (int i = 0; i < 3; i++)
+                consoleLog.setLevel(logCategories[i], static_cast<Astrometers::LogLevel>(LogLevelsN[i].value));
+            LogLevelsNP.s = IPS_OK;
+            IDSetNumber(&LogLevelsNP, nullptr);
+            return true;
+        }
         
-        switch (counter % 3)
+        // History export
+        if (!strcmp(name, HistoryExportNP.name))
         {
-            case 0:
-                // Hygro: temperature, humidity
-                snprintf(buffer, sizeof(buffer), "$hygro,%.2f,%.2f", 
-                        25.0 + (counter % 20), 45.0 + (counter % 30));
-                break;
-            case 1:
-                // Light: lux, raw1, raw2, gain, integration_time
-                snprintf(buffer, sizeof(buffer), "$light,%.2f,%d,%d,%d,%d", 
-                        1500.0 + (counter % 1000), 4500 + (counter % 500), 
-                        2100 + (counter % 200), 1, 300);
-                break;
-            case 2:
-                // Cloud: 5 sky temperatures (ADC values)
-                snprintf(buffer, sizeof(buffer), "$cloud,%.2f,%.2f,%.2f,%.2f,%.2f",
-                        65100.0 + (counter % 50), 65140.0 + (counter % 40), 
-                        65050.0 + (counter % 30), 65070.0 + (counter % 45),
-                        65100.0 + (counter % 35));
-                break;
+            IUUpdateNumber(&HistoryExportNP, values, names, n);
+            HistoryExportNP.s = exportHistory(HistoryExportN[0].value) ? IPS_OK : IPS_ALERT;
+            IDSetNumber(&HistoryExportNP, nullptr);
+            return true;
         }
         
-        nbytes_read = strlen(buffer);
-        processData(std::string(buffer));
-        return true;
+        // Filter and safety settings take effect with the next value, the replay speed with the next start
+        INumberVectorProperty *settings[] = { &PublishDeadbandNP, &PublishIntervalNP, &PublishHeartbeatNP,
+                                              &SafetyThresholdsNP, &LightWindowNP, &ReplaySpeedNP };
+        for (auto setting : settings)
+        {
+            if (!strcmp(name, setting->name))
+            {
+                IUUpdateNumber(setting, values, names, n);
+                setting->s = IPS_OK;
+                IDSetNumber(setting, nullptr);
+                return true;
+            }
+        }
     }
+    
+    return INDI::Weather::ISNewNumber(dev, name, values, names, n);
+}
+
+bool AMSKY01::saveConfigItems(FILE *fp)
+{
+    INDI::Weather::saveConfigItems(fp);
+    
+    // Recording choice and location survive restarts, the config load turns recording on again
+    IUSaveConfigText(fp, &HistoryDirTP);
+    IUSaveConfigSwitch(fp, &HistoryRecordSP);
+    return true;
+}
+
+void AMSKY01::debugTriggered(bool enable)
+{
+    INDI::Weather::debugTriggered(enable);
+    
+    // INDI debug opens up every console category
+    consoleLog.setDebug(enable);
+}
+
+void AMSKY01::TimerHit()
+{
+    if (!isConnected())
+        return;
+        
+    // Real hardware is read by the reader thread, only the simulator runs on the timer
+    if (isSimulation() && !replayActive)
+        generateSimulatedData();
+        
+    // Values held back by their interval and the heartbeat go out from here
+    if (flushParameters())
+        LOG_DEBUG("Published held back weather parameters");
+        
+    // Rollups also age while no data arrives
+    auto now = std::chrono::steady_clock::now();
+    if (std::chrono::duration<double>(now - lastRollupPublish).count() >= ROLLUP_PERIOD)
+        publishRollups();
+        
+    SetTimer(PUBLISH_TICK);
+}
 
-    LOGF_DEBUG("Reading serial data from FD %d", PortFD);
+void AMSKY01::generateSimulatedData()
+{
+    char buffer[SAMPLE_LINE_SIZE] = {0};
     
-    // Try to read a line of data (ending with newline)
-    int tty_rc = tty_read_section(PortFD, buffer, '\n', 3, &nbytes_read);
+    // Generate realistic AMSKY01 test data
+    static int counter = 0;
+    counter++;
     
-    if (tty_rc == TTY_OK && nbytes_read > 0)
+    switch (counter % 3)
     {
-        buffer[nbytes_read - 1] = '\0'; // Remove newline
-        std::string dataLine(buffer);
-        processData(dataLine);
-        return true;
+        case 0:
+            // Hygro: temperature, humidity
+            snprintf(buffer, sizeof(buffer), "$hygro,%.2f,%.2f", 
+                    25.0 + (counter % 20), 45.0 + (counter % 30));
+            break;
+        case 1:
+            // Light: lux, raw1, raw2, gain, integration_time
+            snprintf(buffer, sizeof(buffer), "$light,%.2f,%d,%d,%d,%d", 
+                    1500.0 + (counter % 1000), 4500 + (counter % 500), 
+                    2100 + (counter % 200), 1, 300);
+            break;
+        case 2:
+            // Cloud: 5 sky temperatures (ADC values)
+            snprintf(buffer, sizeof(buffer), "$cloud,%.2f,%.2f,%.2f,%.2f,%.2f",
+                    65100.0 + (counter % 50), 65140.0 + (counter % 40), 
+                    65050.0 + (counter % 30), 65070.0 + (counter % 45),
+                    65100.0 + (counter % 35));
+            break;
     }
-    else if (tty_rc == TTY_TIME_OUT)
-    {
-        // Timeout is normal when no data is available
+    
+    processData(std::string_view(buffer, strlen(buffer)));
+}
+
+void AMSKY01::processData(std::string_view line)
+{
+    Sample sample;
+    sample.timestamp = sample.queuedAt = std::chrono::steady_clock::now();
+    sample.length = static_cast<uint16_t>(std::min(line.size(), SAMPLE_LINE_SIZE));
+    memcpy(sample.line, line.data(), sample.length);
+    
+    parseSentence(sample);
+    ingestSample(sample);
+    publishCycle();
+}
+
+bool AMSKY01::startReaderThread()
+{
+    if (readerThread.joinable())
         return true;
-    }
-    else if (tty_rc != TTY_OK)
+        
+    if (PortFD < 0)
+        return false;
+        
+    readerStopFD = eventfd(0, EFD_CLOEXEC);
+    if (readerStopFD < 0 || !openSampleChannel())
     {
-        char errorMessage[MAXRBUF];
-        tty_error_msg(tty_rc, errorMessage, MAXRBUF);
-        LOGF_DEBUG("Serial read error: %s", errorMessage);
+        LOGF_ERROR("Failed to create eventfd: %s", strerror(errno));
+        stopReaderThread();
         return false;
     }
     
+    readerError = 0;
+    readerRunning = true;
+    readerThread = std::thread(&AMSKY01::readerThreadLoop, this, PortFD);
     return true;
 }
 
-void AMSKY01::processData(const std::string& data)
+void AMSKY01::stopReaderThread()
 {
-    if (data.empty())
-        return;
-        
-    // Ignoruj řádky nezačínající $
-    if (data[0] != '$')
-        return;
-        
-    // Print to console with timestamp
-    time_t rawtime;
-    struct tm * timeinfo;
-    char timestamp[80];
+    readerRunning = false;
     
-    time(&rawtime);
-    timeinfo = localtime(&rawtime);
-    strftime(timestamp, sizeof(timestamp), "%H:%M:%S", timeinfo);
+    if (readerThread.joinable())
+    {
+        uint64_t wake = 1;
+        ssize_t rc = write(readerStopFD, &wake, sizeof(wake));
+        INDI_UNUSED(rc);
+        readerThread.join();
+    }
     
-    // Print to console
-    printf("[AMSKY01] [%s] DATA: %s\n", timestamp, data.c_str());
-    std::cout.flush();
+    closeSampleChannel();
     
-    // Parse weather data
-    if (parseHygro(data) || parseLight(data) || parseCloud(data))
+    if (readerStopFD >= 0)
     {
-        weatherData.dataValid = (weatherData.hygroValid || weatherData.lightValid || weatherData.cloudValid);
-        
-        // Update weather parameters
-        if (weatherData.hygroValid)
-        {
-            setParameterValue("WEATHER_TEMPERATURE", weatherData.temperature);
-            setParameterValue("WEATHER_HUMIDITY", weatherData.humidity);
-            setParameterValue("WEATHER_DEW_POINT", weatherData.dewPoint);
-        }
-        
-        if (weatherData.lightValid)
-        {
-            setParameterValue("WEATHER_LIGHT_LUX", weatherData.lux);
-            setParameterValue("WEATHER_SKY_BRIGHTNESS", weatherData.skyBrightness);
-        }
-        
-        if (weatherData.cloudValid)
-        {
-            setParameterValue("WEATHER_SKY_TEMPERATURE", weatherData.avgCloudTemp);
-            setParameterValue("WEATHER_CLOUD_COVER", weatherData.cloudCover);
-            
-            // Aktualizuj všechny individuální sky teploty
-            setParameterValue("WEATHER_SKY_TEMP_1", weatherData.cloudTemp[0]);
-            setParameterValue("WEATHER_SKY_TEMP_2", weatherData.cloudTemp[1]);
-            setParameterValue("WEATHER_SKY_TEMP_3", weatherData.cloudTemp[2]);
-            setParameterValue("WEATHER_SKY_TEMP_4", weatherData.cloudTemp[3]);
-            setParameterValue("WEATHER_SKY_TEMP_5", weatherData.cloudTemp[4]);
-        }
+        close(readerStopFD);
+        readerStopFD = -1;
     }
-    
-    LOGF_INFO("Received data: %s", data.c_str());
 }
 
-// Weather-specific functions
-IPState AMSKY01::updateWeather()
+bool AMSKY01::openSampleChannel()
 {
-    if (weatherData.dataValid)
-        return IPS_OK;
-    else
-        return IPS_BUSY;
+    sampleFD = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    if (sampleFD < 0)
+        return false;
+        
+    sampleQueue.clear();
+    droppedLines = 0;
+    
+    // Samples are applied on the INDI event loop
+    sampleCallbackID = IEAddCallback(sampleFD, sampleCallback, this);
+    return true;
 }
 
-bool AMSKY01::parseHygro(const std::string& data)
+void AMSKY01::closeSampleChannel()
 {
-    // Parse: $hygro,temperature,humidity
-    if (data.find("$hygro,") == 0)
+    if (sampleCallbackID >= 0)
     {
-        std::vector<std::string> tokens;
-        std::stringstream ss(data);
-        std::string token;
-        
-        while (std::getline(ss, token, ','))
-        {
-            tokens.push_back(token);
-        }
-        
-        if (tokens.size() >= 3)
-        {
-            try
-            {
-                weatherData.temperature = std::stod(tokens[1]);
-                weatherData.humidity = std::stod(tokens[2]);
-                
-                // Calculate dew point using Magnus formula
-                double a = 17.27;
-                double b = 237.7;
-                double alpha = ((a * weatherData.temperature) / (b + weatherData.temperature)) + log(weatherData.humidity / 100.0);
-                weatherData.dewPoint = (b * alpha) / (a - alpha);
-                
-                weatherData.hygroValid = true;
-                
-                printf("[AMSKY01]   🌡️  Temperature: %.1f°C, Humidity: %.1f%%, Dew Point: %.1f°C\n", 
-                       weatherData.temperature, weatherData.humidity, weatherData.dewPoint);
-                std::cout.flush();
-                return true;
-            }
-            catch (const std::exception& e)
-            {
-                LOGF_ERROR("Error parsing hygro data: %s", e.what());
-            }
-        }
+        IERmCallback(sampleCallbackID);
+        sampleCallbackID = -1;
+    }
+    
+    if (sampleFD >= 0)
+    {
+        close(sampleFD);
+        sampleFD = -1;
     }
-    return false;
 }
 
-bool AMSKY01::parseLight(const std::string& data)
+void AMSKY01::readerThreadLoop(int fd)
 {
-    // Parse: $light,lux,raw1,raw2,gain,integration_time_ms
-    if (data.find("$light,") == 0)
+    char chunk[READ_CHUNK_SIZE];
+    Sample *slot = nullptr;
+    size_t length = 0;
+    bool dropping = false;
+    
+    struct pollfd fds[2];
+    fds[0].fd = fd;
+    fds[0].events = POLLIN;
+    fds[1].fd = readerStopFD;
+    fds[1].events = POLLIN;
+    
+    while (readerRunning)
     {
-        std::vector<std::string> tokens;
-        std::stringstream ss(data);
-        std::string token;
+        fds[0].revents = 0;
+        fds[1].revents = 0;
         
-        while (std::getline(ss, token, ','))
+        // Block until the device sends something or the driver stops us
+        if (poll(fds, 2, -1) < 0)
         {
-            tokens.push_back(token);
+            if (errno == EINTR)
+                continue;
+            readerError = errno;
+            break;
         }
         
-        if (tokens.size() >= 6)
+        if (fds[1].revents)
+            break;
+            
+        ssize_t nbytes = read(fd, chunk, sizeof(chunk));
+        if (nbytes < 0 && (errno == EINTR || errno == EAGAIN))
+            continue;
+        if (nbytes <= 0)
         {
-            try
-            {
-                weatherData.lux = std::stod(tokens[1]);
-                weatherData.raw1 = std::stoi(tokens[2]);
-                weatherData.raw2 = std::stoi(tokens[3]);
-                weatherData.gain = std::stoi(tokens[4]);
-                weatherData.integrationTime = std::stoi(tokens[5]);
-                
-                // Convert lux to sky brightness (lepší aproximace)
-                // Velmi tmavá obloha: ~22 mag/arcsec² při <0.01 lux
-                // Jasná obloha při úplňku: ~19 mag/arcsec² při ~0.1 lux  
-                // Městské světlo: ~16-18 mag/arcsec² při >10 lux
-
-                weatherData.lux = (static_cast<float>(weatherData.raw1) / static_cast<float>(weatherData.gain)) / static_cast<float>(weatherData.integrationTime);
-                weatherData.lux *= 1000000.0;
-
-                if (weatherData.lux < 0.001)
-                    weatherData.skyBrightness = 22.0;
-                else
-                    weatherData.skyBrightness = 22.0 - 2.5 * log10(weatherData.lux * 100);
-                
-                // Omez na rozumné hodnoty
-                if (weatherData.skyBrightness < 15.0) weatherData.skyBrightness = 15.0;
-                if (weatherData.skyBrightness > 22.5) weatherData.skyBrightness = 22.5;
-                
-                weatherData.lightValid = true;
-                
-                printf("[AMSKY01]   ☀️  Light: %.1f lux (raw1:%d, raw2:%d, gain:%d, int:%dms), Sky: %.1f mag/arcsec²\n", 
-                       weatherData.lux, weatherData.raw1, weatherData.raw2, weatherData.gain, 
-                       weatherData.integrationTime, weatherData.skyBrightness);
-                std::cout.flush();
-                return true;
-            }
-            catch (const std::exception& e)
-            {
-                LOGF_ERROR("Error parsing light data: %s", e.what());
-            }
+            readerError = (nbytes < 0) ? errno : EIO;
+            break;
         }
-    }
-    return false;
-}
-
-bool AMSKY01::parseCloud(const std::string& data)
-{
-    // Parse: $cloud,temp1,temp2,temp3,temp4,temp5 (4 segmenty + zenit)
-    if (data.find("$cloud,") == 0)
-    {
-        std::vector<std::string> tokens;
-        std::stringstream ss(data);
-        std::string token;
         
-        while (std::getline(ss, token, ','))
-        {
-            tokens.push_back(token);
-        }
+        auto now = std::chrono::steady_clock::now();
+        bool delivered = false;
         
-        if (tokens.size() >= 6)
+        for (ssize_t i = 0; i < nbytes; i++)
         {
-            try
+            char c = chunk[i];
+            
+            if (c == '\n')
             {
-                // Načti 5 teplot oblohy
-                double tempSum = 0.0;
-                for (int i = 0; i < 5; i++)
+                if (slot != nullptr)
                 {
-                    weatherData.cloudTemp[i] = std::stod(tokens[i + 1]);
-                    tempSum += weatherData.cloudTemp[i];
+                    slot->timestamp = slot->queuedAt = now;
+                    slot->length = static_cast<uint16_t>(length);
+                    parseSentence(*slot);
+                    sampleQueue.publish();
+                    delivered = true;
                 }
-                
-                weatherData.avgCloudTemp = tempSum / 5.0;
-                
-                double minSkyTemp = 64000.0;  // jasná studená obloha
-                double maxSkyTemp = 66000.0;  // velmi oblačno
-                
-                weatherData.cloudCover = ((weatherData.avgCloudTemp - minSkyTemp) / (maxSkyTemp - minSkyTemp)) * 100.0;
-                if (weatherData.cloudCover < 0.0) weatherData.cloudCover = 0.0;
-                if (weatherData.cloudCover > 100.0) weatherData.cloudCover = 100.0;
-                
-                weatherData.cloudValid = true;
-                
-                printf("[AMSKY01]   ☁️  Sky Temps: %.1f, %.1f, %.1f, %.1f, %.1f (avg: %.1f), Cloud Cover: %.1f%%\n",
-                       weatherData.cloudTemp[0], weatherData.cloudTemp[1], weatherData.cloudTemp[2], 
-                       weatherData.cloudTemp[3], weatherData.cloudTemp[4], weatherData.avgCloudTemp, weatherData.cloudCover);
-                std::cout.flush();
-                return true;
+                slot = nullptr;
+                length = 0;
+                dropping = false;
+                continue;
             }
-            catch (const std::exception& e)
+            
+            // A new line goes straight into the next free queue slot
+            if (slot == nullptr)
             {
-                LOGF_ERROR("Error parsing cloud data: %s", e.what());
+                if (dropping)
+                    continue;
+                    
+                slot = sampleQueue.claim();
+                if (slot == nullptr)
+                {
+                    // Main loop is behind, drop the whole line rather than block the port
+                    droppedLines.fetch_add(1, std::memory_order_relaxed);
+                    dropping = true;
+                    continue;
+                }
             }
+            
+            // Overlong lines are cut, they fail to parse anyway
+            if (length < SAMPLE_LINE_SIZE)
+                slot->line[length++] = c;
+        }
+        
+        // One wakeup per read, the main loop drains everything queued so far
+        if (delivered)
+        {
+            uint64_t wake = 1;
+            ssize_t rc = write(sampleFD, &wake, sizeof(wake));
+            INDI_UNUSED(rc);
         }
     }
-    return false;
+    
+    // Let the main loop report why reading stopped
+    if (readerError != 0)
+    {
+        uint64_t wake = 1;
+        ssize_t rc = write(sampleFD, &wake, sizeof(wake));
+        INDI_UNUSED(rc);
+    }
+}
+
+void AMSKY01::sampleCallback(int fd, void *userpointer)
+{
+    // Reset the eventfd counter, the queue itself tells how much work is pending
+    uint64_t count;
+    ssize_t rc = read(fd, &count, sizeof(count));
+    INDI_UNUSED(rc);
+    
+    static_cast<AMSKY01 *>(userpointer)->processSamples();
+}
+
+void AMSKY01::processSamples()
+{
+    using namespace std::chrono;
+    
+    // Queue is FIFO, so the first sample is the one that waited longest
+    steady_clock::time_point first;
+    double sinceFirst = 0;
+    uint64_t drained = 0;
+    
+    // Checked first: the replay thread flags the end only after its last line is queued
+    bool finished = replayFinished.exchange(false);
+    
+    // Drain every complete line, however many arrived since the last wakeup
+    while (const Sample *sample = sampleQueue.front())
+    {
+        if (drained++ == 0)
+            first = sample->queuedAt;
+        sinceFirst += duration<double, std::micro>(sample->queuedAt - first).count();
+        
+        ingestSample(*sample);
+        sampleQueue.release();
+    }
+    
+    uint32_t dropped = droppedLines.exchange(0, std::memory_order_relaxed);
+    if (dropped > 0)
+    {
+        linesDropped += dropped;
+        LOGF_WARN("Sample queue full, %u lines dropped", dropped);
+    }
+    
+    publishCycle();
+    
+    // End-to-end latency of a replayed line: queued by the replay thread until published
+    if (replayActive && drained > 0)
+    {
+        auto now = steady_clock::now();
+        double oldest = duration<double, std::micro>(now - first).count();
+        replayIngested += drained;
+        replayLatencySum += drained * oldest - sinceFirst;
+        replayLatencyMax = std::max(replayLatencyMax, oldest);
+        replayLastIngest = now;
+    }
+
+    int error = readerError.exchange(0);
+    if (error != 0)
+        LOGF_ERROR("Serial read error: %s", strerror(error));
+        
+    if (finished)
+        finishReplay();
+}
+
+void AMSKY01::parseSentence(Sample &sample)
+{
+    std::string_view line(sample.line, sample.length);
+    
+    // Strip line terminators left by the device
+    while (!line.empty() && (line.back() == '\r' || line.back() == '\n'))
+        line.remove_suffix(1);
+    sample.length = static_cast<uint16_t>(line.size());
+    
+    sample.sentence = SENTENCE_NONE;
+    sample.valid = false;
+    
+    // Ignoruj řádky nezačínající $
+    if (line.size() < 2 || line[0] != '$')
+        return;
+        
+    // Split in place, the fields point into line
+    std::string_view fields[MAX_SENTENCE_FIELDS];
+    size_t count = Astrometers::Proto::splitFields(line.substr(1), fields, MAX_SENTENCE_FIELDS);
+    
+    // One table lookup picks the sentence, its parser is generated from the schema
+    int sentence = SkySchema::findSentence(fields[0]);
+    sample.sentence = (sentence >= 0) ? sentence : SENTENCE_UNKNOWN;
+    if (sentence >= 0)
+        sample.valid = SkySchema::PARSERS[sentence](fields, count, sample.fields, sample.parameters);
+}
+
+void AMSKY01::ingestSample(const Sample &sample)
+{
+    if (sample.sentence == SENTENCE_NONE)
+        return;
+        
+    consoleLog.log(logData, Astrometers::LogLevel::Debug, "%.*s", static_cast<int>(sample.length), sample.line);
+    linesReceived++;
+    
+    if (sample.sentence == SENTENCE_UNKNOWN)
+        return;
+        
+    int index = sample.sentence;
+    if (!sample.valid)
+    {
+        parseErrors++;
+        std::string_view tag = SkySchema::SENTENCES[index].tag;
+        consoleLog.log(logData, Astrometers::LogLevel::Error, "Error parsing %.*s data: %.*s", static_cast<int>(tag.size()),
+                       tag.data(), static_cast<int>(sample.length), sample.line);
+        return;
+    }
+    
+    // Safety, ranging and the rolling windows see every sample, coalescing
+    // only applies to publishing, so a spike inside a burst still reaches MAX
+    evaluateSafety(sample);
+    if (index == SENTENCE_LIGHT)
+        rangeLight(sample);
+    
+    int first = SkySchema::PARAMETER_OFFSETS[index];
+    for (size_t i = 0; i < SkySchema::SENTENCES[index].parameterCount; i++)
+        addRollup(first + i, sample.parameters[i], sample.timestamp);
+    
+    // Latest wins, an older sample of the same type is never published
+    if (pendingValid[index])
+        samplesSuperseded++;
+        
+    pendingSamples[index] = sample;
+    pendingValid[index] = true;
+}
+
+void AMSKY01::publishCycle()
+{
+    bool updated = false;
+    std::chrono::steady_clock::time_point oldest = std::chrono::steady_clock::time_point::max();
+    std::chrono::steady_clock::time_point newest = std::chrono::steady_clock::time_point::min();
+    
+    for (int i = 0; i < SENTENCE_TYPES; i++)
+    {
+        if (!pendingValid[i])
+            continue;
+            
+        const Sample &sample = pendingSamples[i];
+        applySample(sample);
+        
+        oldest = std::min(oldest, sample.queuedAt);
+        newest = std::max(newest, sample.timestamp);
+        pendingValid[i] = false;
+        updated = true;
+    }
+    
+    if (updated)
+    {
+        weatherData.dataValid = true;
+        recordHistory(newest);
+        
+        // One update per property per cycle, however many lines were folded into it
+        if (flushParameters())
+        {
+            auto age = std::chrono::steady_clock::now() - oldest;
+            LOGF_DEBUG("Published samples up to %.3f ms after arrival", std::chrono::duration<double, std::milli>(age).count());
+        }
+    }
+
+    auto now = std::chrono::steady_clock::now();
+    if (std::chrono::duration<double>(now - lastStatsPublish).count() >= INGEST_STATS_PERIOD)
+        publishIngestStats();
+}
+
+void AMSKY01::evaluateSafety(const Sample &sample)
+{
+    // Only the conditions whose parameter this sentence carries
+    int first = SkySchema::PARAMETER_OFFSETS[sample.sentence];
+    int count = SkySchema::SENTENCES[sample.sentence].parameterCount;
+    
+    bool changed = false;
+    for (int i = 0; i < SAFETY_CONDITIONS; i++)
+    {
+        int param = SAFETY_RULES[i].parameter - first;
+        if (param >= 0 && param < count && updateSafety(static_cast<SafetyCondition>(i), sample.parameters[param]))
+            changed = true;
+    }
+    
+    if (changed)
+        pushSafety(sample);
+}
+
+bool AMSKY01::updateSafety(SafetyCondition condition, double value)
+{
+    SafetyState &state = safetyState[condition];
+    
+    // Hysteresis: leaving the unsafe state needs the lower threshold
+    bool flip = state.unsafe ? value <= SafetyThresholdsN[2 * condition + 1].value
+                             : value >= SafetyThresholdsN[2 * condition].value;
+    if (!flip)
+    {
+        state.count = 0;
+        return false;
+    }
+    
+    // A single outlier does not move the roof
+    if (++state.count < SafetyThresholdsN[2 * SAFETY_CONDITIONS].value)
+        return false;
+        
+    state.unsafe = !state.unsafe;
+    state.count = 0;
+    return true;
+}
+
+void AMSKY01::pushSafety(const Sample &trigger)
+{
+    bool unsafe = false;
+    for (int i = 0; i < SAFETY_CONDITIONS; i++)
+    {
+        SafetyL[i].s = safetyState[i].unsafe ? IPS_ALERT : IPS_OK;
+        unsafe = unsafe || safetyState[i].unsafe;
+    }
+    
+    // Straight to the critical parameters, the other values keep their own cadence
+    setParameterValue(SAFETY_PARAMETER, unsafe ? 1 : 0);
+    if (syncCriticalParameters())
+        critialParametersLP.apply();
+    ParametersNP.apply();
+    
+    SafetyLP.s = unsafe ? IPS_ALERT : IPS_OK;
+    IDSetLight(&SafetyLP, nullptr);
+    
+    auto latency = std::chrono::steady_clock::now() - trigger.queuedAt;
+    double ms = std::chrono::duration<double, std::milli>(latency).count();
+    if (unsafe)
+        LOGF_WARN("Unsafe conditions (%.*s), pushed %.3f ms after the sample arrived", static_cast<int>(trigger.length),
+                  trigger.line, ms);
+    else
+        LOGF_INFO("Conditions safe again, pushed %.3f ms after the sample arrived", ms);
+}
+
+void AMSKY01::resetSafety()
+{
+    for (auto &state : safetyState)
+        state = SafetyState();
+        
+    for (auto &light : SafetyL)
+        light.s = IPS_IDLE;
+    SafetyLP.s = IPS_IDLE;
+    IDSetLight(&SafetyLP, nullptr);
+    
+    setParameterValue(SAFETY_PARAMETER, 0);
+}
+
+void AMSKY01::rangeLight(const Sample &sample)
+{
+    static constexpr int RAW = SkySchema::fieldIndex("light", "raw1");
+    static constexpr int GAIN = SkySchema::fieldIndex("light", "gain");
+    static constexpr int INTEGRATION_TIME = SkySchema::fieldIndex("light", "integration_time");
+    
+    lightSamples++;
+    LightRanging::Setting current {static_cast<int>(sample.fields[GAIN]), static_cast<int>(sample.fields[INTEGRATION_TIME])};
+    LightRangingN[0].value = current.gain;
+    LightRangingN[1].value = current.integrationTime;
+    
+    LightRanging::Setting next;
+    lightRanging.setWindow(LightWindowN[0].value, LightWindowN[1].value);
+    if (!lightRanging.recommend(sample.fields[RAW], current, next))
+        next = current;
+        
+    // Logged when the advice changes, not on every sample that repeats it
+    if (next != current && next != lightAdvice)
+        consoleLog.log(logLink, Astrometers::LogLevel::Info, "Light sensor %.0f counts at gain %d / %d ms, gain %d / %d ms would fit better",
+                       sample.fields[RAW], current.gain, current.integrationTime, next.gain, next.integrationTime);
+    lightAdvice = next;
+}
+
+void AMSKY01::publishLightRanging()
+{
+    auto now = std::chrono::steady_clock::now();
+    double elapsed = std::chrono::duration<double>(now - lastLightReport).count();
+    
+    // Light samples arrive once per integration, shorter integrations mean more of them
+    LightRangingN[2].value = elapsed > 0 ? (lightSamples - lightSamplesReported) * 60.0 / elapsed : 0;
+    LightRangingN[3].value = lightAdvice.gain;
+    LightRangingN[4].value = lightAdvice.integrationTime;
+    
+    // Busy while the sensor runs outside the advised range
+    LightRanging::Setting current {static_cast<int>(LightRangingN[0].value), static_cast<int>(LightRangingN[1].value)};
+    LightRangingNP.s = (lightAdvice.gain == 0 || lightAdvice == current) ? IPS_OK : IPS_BUSY;
+    IDSetNumber(&LightRangingNP, nullptr);
+    
+    lightSamplesReported = lightSamples;
+    lastLightReport = now;
+}
+
+void AMSKY01::updateParameter(int param, double value)
+{
+    publishState[param].value = value;
+    publishState[param].hasValue = true;
+}
+
+void AMSKY01::addRollup(int param, double value, std::chrono::steady_clock::time_point when)
+{
+    RollupMetric metric;
+    switch (param)
+    {
+        case PARAM_SKY_TEMPERATURE:
+            metric = ROLLUP_SKY_TEMPERATURE;
+            break;
+        case PARAM_CLOUD_COVER:
+            metric = ROLLUP_CLOUD_COVER;
+            break;
+        case PARAM_SKY_BRIGHTNESS:
+            metric = ROLLUP_SKY_BRIGHTNESS;
+            break;
+        case PARAM_HUMIDITY:
+            metric = ROLLUP_HUMIDITY;
+            break;
+        default:
+            return;
+    }
+    
+    // A sample from before the newest one comes from another timebase, live
+    // data after a replay ran ahead of the clock
+    if (when < rollupClock)
+        resetRollups();
+    rollupClock = when;
+    
+    double seconds = std::chrono::duration<double>(when.time_since_epoch()).count();
+    for (auto &window : rollups[metric])
+        window.add(seconds, value);
+}
+
+void AMSKY01::resetRollups()
+{
+    for (auto &metric : rollups)
+    {
+        for (int tier = 0; tier < ROLLUP_TIERS; tier++)
+            metric[tier].reset(ROLLUP_WINDOWS[tier].span);
+    }
+    
+    lastRollupPublish = std::chrono::steady_clock::time_point();
+    rollupClock = std::chrono::steady_clock::time_point();
+}
+
+void AMSKY01::publishRollups()
+{
+    auto now = std::chrono::steady_clock::now();
+    lastRollupPublish = now;
+    
+    // A replay ages the windows by the capture's clock, not by how fast it is fed
+    auto clock = replayActive ? rollupClock : now;
+    double seconds = std::chrono::duration<double>(clock.time_since_epoch()).count();
+    
+    // Busy while any window is still empty, at startup or when a sensor went quiet
+    bool complete = true;
+    for (int metric = 0; metric < ROLLUP_METRICS; metric++)
+    {
+        for (int tier = 0; tier < ROLLUP_TIERS; tier++)
+        {
+            RollingWindow<ROLLUP_SLOTS> &window = rollups[metric][tier];
+            window.expire(seconds);
+            
+            INumber *values = &RollupsN[(metric * ROLLUP_TIERS + tier) * 3];
+            values[0].value = window.mean();
+            values[1].value = window.min();
+            values[2].value = window.max();
+            complete = complete && window.count() > 0;
+        }
+    }
+    
+    RollupsNP.s = complete ? IPS_OK : IPS_BUSY;
+    IDSetNumber(&RollupsNP, nullptr);
+}
+
+bool AMSKY01::flushParameters()
+{
+    using namespace std::chrono;
+    
+    auto now = steady_clock::now();
+    bool heartbeat = duration<double>(now - lastParametersPublish).count() >= PublishHeartbeatN[0].value;
+    bool changed = false;
+    bool any = false;
+    
+    for (int i = 0; i < PARAM_COUNT; i++)
+    {
+        PublishState &state = publishState[i];
+        if (!state.hasValue)
+            continue;
+            
+        any = true;
+        bool moved = !state.hasPublished || std::fabs(state.value - state.published) >= PublishDeadbandN[i].value;
+        bool due = !state.hasPublished || duration<double, std::milli>(now - state.lastPublish).count() >= PublishIntervalN[i].value;
+        
+        // The heartbeat also brings out changes that stayed inside the deadband
+        if ((moved && due) || (heartbeat && state.value != state.published))
+        {
+            setParameterValue(PARAMETERS[i].name, state.value);
+            state.published = state.value;
+            state.hasPublished = true;
+            state.lastPublish = now;
+            changed = true;
+        }
+    }
+    
+    if (!changed && !(heartbeat && any))
+        return false;
+        
+    if (syncCriticalParameters())
+        critialParametersLP.apply();
+    ParametersNP.setState(IPS_OK);
+    ParametersNP.apply();
+    lastParametersPublish = now;
+    return true;
+}
+
+void AMSKY01::resetPublishState()
+{
+    for (auto &state : publishState)
+        state = PublishState();
+        
+    lastParametersPublish = std::chrono::steady_clock::now();
+}
+
+void AMSKY01::publishIngestStats()
+{
+    lastStatsPublish = std::chrono::steady_clock::now();
+    
+    IngestStatsN[0].value = linesReceived;
+    IngestStatsN[1].value = samplesSuperseded;
+    IngestStatsN[2].value = parseErrors;
+    IngestStatsN[3].value = linesDropped;
+    IngestStatsNP.s = (parseErrors + linesDropped > 0) ? IPS_BUSY : IPS_OK;
+    IDSetNumber(&IngestStatsNP, nullptr);
+    
+    if (historyStore.isOpen())
+        publishHistoryStats();
+    publishLightRanging();
+    if (replayActive)
+        publishReplayStats();
+}
+
+bool AMSKY01::startHistory()
+{
+    if (historyStore.isOpen())
+        return true;
+        
+    if (!historyStore.open(HistoryDirT[0].text, PARAM_COUNT))
+    {
+        LOGF_ERROR("Failed to open history store in %s", HistoryDirT[0].text);
+        return false;
+    }
+    
+    LOGF_INFO("Recording history to %s", HistoryDirT[0].text);
+    publishHistoryStats();
+    return true;
+}
+
+void AMSKY01::stopHistory()
+{
+    historyStore.close();
+}
+
+void AMSKY01::recordHistory(std::chrono::steady_clock::time_point when)
+{
+    if (!historyStore.isOpen())
+        return;
+        
+    // Latest value of every parameter, filtered or not; NaN until first seen
+    double values[PARAM_COUNT];
+    for (int i = 0; i < PARAM_COUNT; i++)
+        values[i] = publishState[i].hasValue ? publishState[i].value : NAN;
+        
+    // Stamped with when the newest reading was taken, replayed ones at their place in the capture
+    auto taken = std::chrono::system_clock::now() + std::chrono::duration_cast<std::chrono::system_clock::duration>(
+                     when - std::chrono::steady_clock::now());
+    historyStore.append(std::chrono::duration_cast<std::chrono::milliseconds>(taken.time_since_epoch()).count(), values);
+}
+
+void AMSKY01::publishHistoryStats()
+{
+    TimeSeriesStore::Stats stats = historyStore.stats();
+    HistoryStatsN[0].value = stats.records;
+    HistoryStatsN[1].value = stats.segments;
+    HistoryStatsN[2].value = stats.records > 0 ? static_cast<double>(stats.bytes) / stats.records : 0;
+    HistoryStatsN[3].value = stats.dropped;
+    HistoryStatsNP.s = stats.dropped > 0 ? IPS_BUSY : IPS_OK;
+    IDSetNumber(&HistoryStatsNP, nullptr);
+}
+
+bool AMSKY01::exportHistory(double hours)
+{
+    using namespace std::chrono;
+    
+    if (!historyStore.isOpen())
+    {
+        LOG_ERROR("History recording is not enabled");
+        return false;
+    }
+    
+    time_t now = time(nullptr);
+    struct tm local;
+    localtime_r(&now, &local);
+    char fileName[64];
+    strftime(fileName, sizeof(fileName), "/export-%Y%m%d-%H%M%S.csv", &local);
+    std::string path = std::string(HistoryDirT[0].text) + fileName;
+    
+    FILE *fp = fopen(path.c_str(), "w");
+    if (fp == nullptr)
+    {
+        LOGF_ERROR("Cannot write %s: %s", path.c_str(), strerror(errno));
+        return false;
+    }
+    
+    fprintf(fp, "timestamp");
+    for (int i = 0; i < PARAM_COUNT; i++)
+        fprintf(fp, ",%s", PARAMETERS[i].name);
+    fprintf(fp, "\n");
+    
+    // Binary search to the first block in range, then one sequential pass
+    int64_t to = duration_cast<milliseconds>(system_clock::now().time_since_epoch()).count();
+    int64_t from = to - static_cast<int64_t>(hours * 3600 * 1000);
+    size_t count = historyStore.query(from, to, [fp](int64_t timestamp, const double *values)
+    {
+        fprintf(fp, "%.3f", timestamp / 1000.0);
+        for (int i = 0; i < PARAM_COUNT; i++)
+            fprintf(fp, ",%.6g", values[i]);
+        fprintf(fp, "\n");
+    });
+    
+    fclose(fp);
+    LOGF_INFO("Exported %zu records of the last %.1f hours to %s", count, hours, path.c_str());
+    return true;
+}
+
+// Splits a line of a captured serial log into its time stamp and the sentence.
+// Accepts "<seconds> <sentence>" with seconds since any epoch, and the console
+// log format "[AMTEST01] [HH:MM:SS.mmm] DATA INFO: <sentence>". Without a time
+// stamp the whole line is the sentence and false is returned.
+static bool parseReplayLine(std::string_view raw, double &seconds, std::string_view &sentence)
+{
+    while (!raw.empty() && (raw.back() == '\r' || raw.back() == '\n'))
+        raw.remove_suffix(1);
+    sentence = raw;
+    
+    size_t separator = raw.find_first_of(" \t,;");
+    if (separator != std::string_view::npos && separator > 0 && isdigit(static_cast<unsigned char>(raw[0])) &&
+        Astrometers::Proto::decodeDouble(raw.substr(0, separator), seconds))
+    {
+        sentence = raw.substr(separator + 1);
+    }
+    else
+    {
+        // Console capture, the first bracket holding a time of day
+        bool found = false;
+        for (size_t open = raw.find('['); open != std::string_view::npos && !found; open = raw.find('[', open + 1))
+        {
+            size_t close = raw.find(']', open);
+            if (close == std::string_view::npos)
+                break;
+                
+            std::string_view fields[3];
+            int hours = 0, minutes = 0;
+            double secs = 0;
+            if (Astrometers::Proto::splitFields(raw.substr(open + 1, close - open - 1), fields, 3, ':') != 3 ||
+                !Astrometers::Proto::decodeInt(fields[0], hours) ||
+                !Astrometers::Proto::decodeInt(fields[1], minutes) ||
+                !Astrometers::Proto::decodeDouble(fields[2], secs))
+                continue;
+                
+            seconds = hours * 3600 + minutes * 60 + secs;
+            sentence = raw.substr(close + 1);
+            size_t text = sentence.find(": ");
+            if (text != std::string_view::npos)
+                sentence.remove_prefix(text + 2);
+            found = true;
+        }
+        
+        if (!found)
+            return false;
+    }
+    
+    while (!sentence.empty() && (sentence.front() == ' ' || sentence.front() == '\t'))
+        sentence.remove_prefix(1);
+    return true;
+}
+
+bool AMSKY01::startReplay()
+{
+    // Only one thread may feed the sample queue, with hardware that is the serial reader
+    if (!isSimulation())
+    {
+        LOG_ERROR("Replay is only available in simulation mode");
+        return false;
+    }
+    
+    FILE *fp = fopen(ReplayFileT[0].text, "r");
+    if (fp == nullptr)
+    {
+        LOGF_ERROR("Cannot open %s: %s", ReplayFileT[0].text, strerror(errno));
+        return false;
+    }
+    
+    replayStopFD = eventfd(0, EFD_CLOEXEC);
+    if (replayStopFD < 0 || !openSampleChannel())
+    {
+        LOGF_ERROR("Failed to create eventfd: %s", strerror(errno));
+        fclose(fp);
+        stopReplay();
+        return false;
+    }
+    
+    resetIngestStats();
+    resetRollups();
+    replayIngested = 0;
+    replayLatencySum = 0;
+    replayLatencyMax = 0;
+    replayStart = replayLastIngest = std::chrono::steady_clock::now();
+    replayFinished = false;
+    replayActive = true;
+    
+    double speed = ReplaySpeedN[0].value;
+    replayRunning = true;
+    replayThread = std::thread(&AMSKY01::replayThreadLoop, this, fp, speed);
+    
+    if (speed > 0)
+        LOGF_INFO("Replaying %s at %.1fx", ReplayFileT[0].text, speed);
+    else
+        LOGF_INFO("Replaying %s as fast as possible", ReplayFileT[0].text);
+    publishReplayStats();
+    return true;
+}
+
+void AMSKY01::stopReplay()
+{
+    replayRunning = false;
+    
+    if (replayThread.joinable())
+    {
+        uint64_t wake = 1;
+        ssize_t rc = write(replayStopFD, &wake, sizeof(wake));
+        INDI_UNUSED(rc);
+        replayThread.join();
+    }
+    
+    closeSampleChannel();
+    
+    if (replayStopFD >= 0)
+    {
+        close(replayStopFD);
+        replayStopFD = -1;
+    }
+    
+    if (replayActive)
+    {
+        replayActive = false;
+        IUResetSwitch(&ReplaySP);
+        ReplayS[1].s = ISS_ON;
+        ReplaySP.s = IPS_IDLE;
+    }
+}
+
+void AMSKY01::finishReplay()
+{
+    stopReplay();
+    publishReplayStats();
+    
+    LOGF_INFO("Replay finished: %llu sentences at %.1f/s, latency mean %.3f ms, max %.3f ms",
+              static_cast<unsigned long long>(replayIngested), ReplayStatsN[1].value,
+              ReplayStatsN[2].value, ReplayStatsN[3].value);
+              
+    ReplaySP.s = IPS_OK;
+    IDSetSwitch(&ReplaySP, nullptr);
+}
+
+void AMSKY01::replayThreadLoop(FILE *fp, double speed)
+{
+    using namespace std::chrono;
+    
+    char raw[READ_CHUNK_SIZE];
+    auto start = steady_clock::now();
+    auto taken = start;
+    bool hasBase = false;
+    double base = 0, last = 0, dayOffset = 0;
+    int unsignalled = 0;
+    
+    auto wake = [this]()
+    {
+        uint64_t one = 1;
+        ssize_t rc = write(sampleFD, &one, sizeof(one));
+        INDI_UNUSED(rc);
+    };
+    
+    while (replayRunning && fgets(raw, sizeof(raw), fp) != nullptr)
+    {
+        double seconds = 0;
+        std::string_view sentence;
+        bool timed = parseReplayLine(std::string_view(raw, strlen(raw)), seconds, sentence);
+        if (sentence.empty())
+            continue;
+            
+        // Samples keep the capture's time, mapped to start at the replay start;
+        // lines without one share the time of the last line that had it
+        if (timed)
+        {
+            // Console captures only carry the time of day
+            if (hasBase && seconds + dayOffset < last - 43200)
+                dayOffset += 86400;
+            seconds += dayOffset;
+            if (!hasBase)
+            {
+                base = seconds;
+                hasBase = true;
+            }
+            last = seconds;
+            taken = start + duration_cast<steady_clock::duration>(duration<double>(seconds - base));
+        }
+        
+        // Keep the original spacing of the lines, scaled by speed
+        if (timed && speed > 0)
+        {
+            if (unsignalled > 0)
+            {
+                wake();
+                unsignalled = 0;
+            }
+            
+            auto due = start + duration_cast<steady_clock::duration>(duration<double>((seconds - base) / speed));
+            if (!replayWait(due))
+                break;
+        }
+        
+        // Paced playback drops lines like the reader thread would, max speed waits for the main loop
+        Sample *slot = sampleQueue.claim();
+        while (slot == nullptr && speed <= 0 && replayRunning)
+        {
+            if (unsignalled > 0)
+            {
+                wake();
+                unsignalled = 0;
+            }
+            replayWait(steady_clock::now() + microseconds(100));
+            slot = sampleQueue.claim();
+        }
+        
+        if (slot == nullptr)
+        {
+            if (!replayRunning)
+                break;
+            droppedLines.fetch_add(1, std::memory_order_relaxed);
+            continue;
+        }
+        
+        slot->length = static_cast<uint16_t>(std::min(sentence.size(), SAMPLE_LINE_SIZE));
+        memcpy(slot->line, sentence.data(), slot->length);
+        slot->queuedAt = steady_clock::now();
+        slot->timestamp = hasBase ? taken : slot->queuedAt;
+        parseSentence(*slot);
+        sampleQueue.publish();
+        
+        if (speed > 0 || ++unsignalled >= REPLAY_BATCH)
+        {
+            wake();
+            unsignalled = 0;
+        }
+    }
+    
+    fclose(fp);
+    
+    // End of file, the main loop winds the replay up; a stop request is wound up by the caller
+    if (replayRunning)
+        replayFinished = true;
+    wake();
+}
+
+bool AMSKY01::replayWait(std::chrono::steady_clock::time_point until)
+{
+    using namespace std::chrono;
+    
+    struct pollfd fds;
+    fds.fd = replayStopFD;
+    fds.events = POLLIN;
+    
+    while (replayRunning)
+    {
+        auto left = duration_cast<nanoseconds>(until - steady_clock::now()).count();
+        if (left <= 0)
+            return true;
+            
+        struct timespec timeout;
+        timeout.tv_sec = left / 1000000000;
+        timeout.tv_nsec = left % 1000000000;
+        fds.revents = 0;
+        
+        int rc = ppoll(&fds, 1, &timeout, nullptr);
+        if (rc > 0 || (rc < 0 && errno != EINTR))
+            return false;
+    }
+    
+    return false;
+}
+
+void AMSKY01::publishReplayStats()
+{
+    double elapsed = std::chrono::duration<double>(replayLastIngest - replayStart).count();
+    
+    ReplayStatsN[0].value = replayIngested;
+    ReplayStatsN[1].value = elapsed > 0 ? replayIngested / elapsed : 0;
+    ReplayStatsN[2].value = replayIngested > 0 ? replayLatencySum / replayIngested / 1000.0 : 0;
+    ReplayStatsN[3].value = replayLatencyMax / 1000.0;
+    ReplayStatsNP.s = replayActive ? IPS_BUSY : IPS_OK;
+    IDSetNumber(&ReplayStatsNP, nullptr);
+}
+
+void AMSKY01::resetIngestStats()
+{
+    linesReceived = 0;
+    samplesSuperseded = 0;
+    parseErrors = 0;
+    linesDropped = 0;
+    
+    for (auto &valid : pendingValid)
+        valid = false;
+        
+    publishIngestStats();
+}
+
+// Weather-specific functions
+IPState AMSKY01::updateWeather()
+{
+    if (weatherData.dataValid)
+        return IPS_OK;
+    else
+        return IPS_BUSY;
+}
+
+void AMSKY01::applySample(const Sample &sample)
+{
+    const SkySchema::Sentence &sentence = SkySchema::SENTENCES[sample.sentence];
+    int first = SkySchema::PARAMETER_OFFSETS[sample.sentence];
+    
+    for (size_t i = 0; i < sentence.parameterCount; i++)
+        updateParameter(first + i, sample.parameters[i]);
+        
+    weatherData.valid[sample.sentence] = true;
+    
+    if (consoleLog.enabled(logValues, Astrometers::LogLevel::Info))
+    {
+        char text[256];
+        size_t length = 0;
+        for (size_t i = 0; i < sentence.parameterCount && length < sizeof(text); i++)
+        {
+            length += snprintf(text + length, sizeof(text) - length, "%s%s: %.2f %s", i > 0 ? ", " : "",
+                               sentence.parameters[i].label, sample.parameters[i], sentence.parameters[i].unit);
+        }
+        consoleLog.log(logValues, Astrometers::LogLevel::Info, "%s", text);
+    }
 }
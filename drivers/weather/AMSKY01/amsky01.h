@@ -13,6 +13,21 @@
 #include <libindi/indiweather.h>
 #include <libindi/connectionplugins/connectionserial.h>
 
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <string_view>
+#include <thread>
+
+#include "asynclog.h"
+#include "lightranging.h"
+#include "rollingwindow.h"
+#include "skyschema.h"
+#include "spscqueue.h"
+#include "timeseriesstore.h"
+
 namespace Connection
 {
     class Serial;
@@ -29,10 +44,15 @@ public:
     virtual const char *getDefaultName() override;
     
     virtual IPState updateWeather() override;
+    virtual bool Disconnect() override;
     
 protected:
     virtual void TimerHit() override;
     virtual bool ISNewSwitch(const char *dev, const char *name, ISState *states, char *names[], int n) override;
+    virtual bool ISNewNumber(const char *dev, const char *name, double values[], char *names[], int n) override;
+    virtual bool ISNewText(const char *dev, const char *name, char *texts[], char *names[], int n) override;
+    virtual bool saveConfigItems(FILE *fp) override;
+    virtual void debugTriggered(bool enable) override;
 
 private:
     // Serial connection - handled by base Weather class
@@ -43,37 +63,238 @@ private:
     ITextVectorProperty StatusTP;
     IText StatusT[2];  // Device a Status
     
+    // Ingestion statistics
+    INumberVectorProperty IngestStatsNP;
+    INumber IngestStatsN[4];
+    
+    // Console log, written by a background thread
+    Astrometers::AsyncLog consoleLog{"[AMSKY01]"};
+    int logLink = -1;       // connection and reader events
+    int logData = -1;       // raw lines
+    int logValues = -1;     // decoded values
+    INumberVectorProperty LogLevelsNP;
+    INumber LogLevelsN[3];
+
+    // Weather parameters are declared by the sentence schema, in registration
+    // order; these are the ones the driver refers to by name
+    enum WeatherParameter
+    {
+        PARAM_HUMIDITY = SkySchema::parameterIndex("WEATHER_HUMIDITY"),
+        PARAM_SKY_BRIGHTNESS = SkySchema::parameterIndex("WEATHER_SKY_BRIGHTNESS"),
+        PARAM_CLOUD_COVER = SkySchema::parameterIndex("WEATHER_CLOUD_COVER"),
+        PARAM_SKY_TEMPERATURE = SkySchema::parameterIndex("WEATHER_SKY_TEMPERATURE"),
+        PARAM_COUNT = SkySchema::PARAMETER_COUNT
+    };
+    
+    // Publish filter settings, per parameter
+    INumberVectorProperty PublishDeadbandNP;
+    INumber PublishDeadbandN[PARAM_COUNT];
+    INumberVectorProperty PublishIntervalNP;
+    INumber PublishIntervalN[PARAM_COUNT];
+    INumberVectorProperty PublishHeartbeatNP;
+    INumber PublishHeartbeatN[1];
+
+    // Sample::sentence is an index into SkySchema::SENTENCES or one of these
+    static constexpr int SENTENCE_NONE = -2;       // not a $ sentence, ignored
+    static constexpr int SENTENCE_UNKNOWN = -1;
+    static constexpr int SENTENCE_TYPES = SkySchema::SENTENCE_COUNT;
+    static constexpr int SENTENCE_LIGHT = SkySchema::sentenceIndex("light");
+
+    static constexpr size_t SAMPLE_LINE_SIZE = 128;
+    static constexpr size_t SAMPLE_QUEUE_SIZE = 256;
+    static constexpr size_t READ_CHUNK_SIZE = 512;
+    static constexpr size_t MAX_SENTENCE_FIELDS = SkySchema::MAX_FIELDS + 1; // tag and fields
+    
+    // One received line and the values decoded from it. Queue slots double as
+    // the line buffers, the reader thread assembles each line in place.
+    struct Sample
+    {
+        std::chrono::steady_clock::time_point timestamp; // when the reading was taken, capture time in a replay
+        std::chrono::steady_clock::time_point queuedAt;  // when the line was complete
+        int sentence;
+        bool valid;
+        double fields[SkySchema::MAX_FIELDS];
+        double parameters[SkySchema::MAX_PARAMETERS]; // derived, in schema order
+        uint16_t length;
+        char line[SAMPLE_LINE_SIZE];
+    };
+    
     // Data reading
-    bool readSerialData();
-    void processData(const std::string& data);
+    void generateSimulatedData();
+    void processData(std::string_view line);
+    
+    // Serial reader thread, samples reach the INDI event loop through sampleQueue
+    bool startReaderThread();
+    void stopReaderThread();
+    void readerThreadLoop(int fd);
+    static void sampleCallback(int fd, void *userpointer);
+    bool openSampleChannel();
+    void closeSampleChannel();
+    void processSamples();
+    
+    std::thread readerThread;
+    std::atomic<bool> readerRunning{false};
+    std::atomic<int> readerError{0};
+    std::atomic<uint32_t> droppedLines{0};
+    int readerStopFD = -1;
+    int sampleFD = -1;
+    int sampleCallbackID = -1;
+    SPSCQueue<Sample, SAMPLE_QUEUE_SIZE> sampleQueue;
+    
+    // Weather data parsing with the parsers generated from the schema.
+    // Runs on the reader thread, so it only fills the sample.
+    static void parseSentence(Sample &sample);
+    
+    // Ingestion cycle on the INDI event loop: everything queued is drained,
+    // only the newest sample of each type is applied and published once.
+    void ingestSample(const Sample &sample);
+    void publishCycle();
+    void publishIngestStats();
+    void resetIngestStats();
+    
+    Sample pendingSamples[SENTENCE_TYPES];
+    bool pendingValid[SENTENCE_TYPES] = {};
+    uint64_t linesReceived = 0;
+    uint64_t samplesSuperseded = 0;
+    uint64_t parseErrors = 0;
+    uint64_t linesDropped = 0;
+    std::chrono::steady_clock::time_point lastStatsPublish;
+    
+    // Publish filter: a new value reaches the clients once it moved past its deadband
+    // and its minimum interval has passed. The heartbeat resends everything.
+    struct PublishState
+    {
+        double value = 0;
+        double published = 0;
+        bool hasValue = false;
+        bool hasPublished = false;
+        std::chrono::steady_clock::time_point lastPublish;
+    };
+    
+    void updateParameter(int param, double value);
+    bool flushParameters();
+    void resetPublishState();
     
-    // Weather data parsing
-    bool parseHygro(const std::string& data);
-    bool parseLight(const std::string& data);
-    bool parseCloud(const std::string& data);
+    PublishState publishState[PARAM_COUNT];
+    std::chrono::steady_clock::time_point lastParametersPublish;
     
-    // Weather values podle skutečných AMSKY01 dat
+    // Light sensor ranging advice: the gain and integration time that would put
+    // the light sentence's raw counts inside the count window. Shown only, the
+    // firmware has no command to change them yet.
+    void rangeLight(const Sample &sample);
+    void publishLightRanging();
+    
+    LightRanging lightRanging;
+    LightRanging::Setting lightAdvice {0, 0};
+    uint64_t lightSamples = 0;
+    uint64_t lightSamplesReported = 0;
+    std::chrono::steady_clock::time_point lastLightReport;
+    INumberVectorProperty LightWindowNP;
+    INumber LightWindowN[2];
+    INumberVectorProperty LightRangingNP;
+    INumber LightRangingN[5];
+    
+    // Safety fast path: every sample is checked against unsafe/safe thresholds and
+    // a state change that persists reaches the critical parameters right away,
+    // not with the next weather update or publish cycle
+    enum SafetyCondition
+    {
+        SAFETY_CLOUD_COVER,
+        SAFETY_HUMIDITY,
+        SAFETY_CONDITIONS
+    };
+    
+    struct SafetyState
+    {
+        bool unsafe = false;
+        int count = 0;      // consecutive samples asking for the other state
+    };
+    
+    void evaluateSafety(const Sample &sample);
+    bool updateSafety(SafetyCondition condition, double value);
+    void pushSafety(const Sample &trigger);
+    void resetSafety();
+    
+    SafetyState safetyState[SAFETY_CONDITIONS];
+    INumberVectorProperty SafetyThresholdsNP;
+    INumber SafetyThresholdsN[SAFETY_CONDITIONS * 2 + 1];   // unsafe/safe pairs, persistence
+    ILightVectorProperty SafetyLP;
+    ILight SafetyL[SAFETY_CONDITIONS];
+    
+    // Rolling mean/min/max of the sky metrics over several windows, so clients
+    // read "the last N minutes" from one property instead of buffering updates
+    enum RollupMetric
+    {
+        ROLLUP_SKY_TEMPERATURE,
+        ROLLUP_CLOUD_COVER,
+        ROLLUP_SKY_BRIGHTNESS,
+        ROLLUP_HUMIDITY,
+        ROLLUP_METRICS
+    };
+    
+    static constexpr int ROLLUP_TIERS = 3;     // 1 min, 10 min, 1 h
+    static constexpr int ROLLUP_SLOTS = 60;
+    
+    void addRollup(int param, double value, std::chrono::steady_clock::time_point when);
+    void resetRollups();
+    void publishRollups();
+    
+    RollingWindow<ROLLUP_SLOTS> rollups[ROLLUP_METRICS][ROLLUP_TIERS];
+    INumberVectorProperty RollupsNP;
+    INumber RollupsN[ROLLUP_METRICS * ROLLUP_TIERS * 3];   // mean, min, max
+    std::chrono::steady_clock::time_point lastRollupPublish;
+    std::chrono::steady_clock::time_point rollupClock;     // newest sample in the windows
+    
+    // Reading history, recorded off the ingest path by the store's writer thread
+    bool startHistory();
+    void stopHistory();
+    void recordHistory(std::chrono::steady_clock::time_point when);
+    void publishHistoryStats();
+    bool exportHistory(double hours);
+    
+    TimeSeriesStore historyStore;
+    ITextVectorProperty HistoryDirTP;
+    IText HistoryDirT[1];
+    ISwitchVectorProperty HistoryRecordSP;
+    ISwitch HistoryRecordS[2];
+    INumberVectorProperty HistoryStatsNP;
+    INumber HistoryStatsN[4];
+    INumberVectorProperty HistoryExportNP;
+    INumber HistoryExportN[1];
+    
+    // Replay of a captured serial log, fed through the reader thread's queue
+    // in simulation mode. Speed 1 is real time, 0 as fast as possible.
+    bool startReplay();
+    void stopReplay();
+    void finishReplay();
+    void replayThreadLoop(FILE *fp, double speed);
+    bool replayWait(std::chrono::steady_clock::time_point until);
+    void publishReplayStats();
+    
+    std::thread replayThread;
+    std::atomic<bool> replayRunning{false};
+    std::atomic<bool> replayFinished{false};
+    int replayStopFD = -1;
+    bool replayActive = false;
+    std::chrono::steady_clock::time_point replayStart;
+    std::chrono::steady_clock::time_point replayLastIngest;
+    uint64_t replayIngested = 0;
+    double replayLatencySum = 0;    // us, lines in the queue until published
+    double replayLatencyMax = 0;    // us
+    ITextVectorProperty ReplayFileTP;
+    IText ReplayFileT[1];
+    INumberVectorProperty ReplaySpeedNP;
+    INumber ReplaySpeedN[1];
+    ISwitchVectorProperty ReplaySP;
+    ISwitch ReplayS[2];
+    INumberVectorProperty ReplayStatsNP;
+    INumber ReplayStatsN[4];
+    
+    // Applying samples to the weather parameters
+    void applySample(const Sample &sample);
+
     struct {
-        // Hygro sensor
-        double temperature = 0.0;   // °C
-        double humidity = 0.0;      // %
-        double dewPoint = 0.0;      // °C (vypočítané)
-        
-        // Light sensor  
-        double lux = 0.0;           // světelnost
-        int raw1 = 0, raw2 = 0;     // raw hodnoty
-        int gain = 0;               // zesílení
-        int integrationTime = 0;    // integrační čas ms
-        double skyBrightness = 0.0; // mag/arcsec² (vypočítané)
-        
-        // Cloud sensor (thermopile)
-        double cloudTemp[5] = {0};  // 5 teplot oblohy (4 segmenty + zenit)
-        double avgCloudTemp = 0.0;  // průměrná teplota oblohy
-        double cloudCover = 0.0;    // oblačnost % (vypočítané)
-        
-        bool hygroValid = false;
-        bool lightValid = false;
-        bool cloudValid = false;
+        bool valid[SENTENCE_TYPES] = {};    // a sentence of this type has been applied
         bool dataValid = false;
     } weatherData;
 };
@@ -0,0 +1,103 @@
+/*
+    Light sensor auto-ranging
+
+    Author: Roman Dvořák <info@astrometers.cz>
+    Copyright (C) 2025 Astrometers
+*/
+
+#pragma once
+
+// Picks gain and integration time for the light sensor from the counts it
+// reports. The count rate (counts per unit gain and ms) is measured from each
+// sample, and the recommended setting is the shortest integration, at the
+// highest gain that does not overshoot, whose predicted counts land inside the
+// good SNR window. A setting is only left when its counts leave the window or a
+// shorter integration fits with margin, so noise at the edges does not flap it.
+//
+// The firmware has no command to change the range yet, so this only advises.
+class LightRanging
+{
+public:
+    struct Setting
+    {
+        int gain;
+        int integrationTime;    // ms
+
+        bool operator==(const Setting &other) const
+        {
+            return gain == other.gain && integrationTime == other.integrationTime;
+        }
+        bool operator!=(const Setting &other) const
+        {
+            return !(*this == other);
+        }
+    };
+
+    void setWindow(double lowCounts, double highCounts)
+    {
+        low = lowCounts;
+        high = highCounts;
+    }
+
+    // Feed the raw counts of one light sample and the setting it was taken with.
+    // Returns true and fills next when another setting would suit the light better.
+    bool recommend(double counts, Setting current, Setting &next) const
+    {
+        if (current.gain <= 0 || current.integrationTime <= 0)
+            return false;
+
+        double rate = counts / (static_cast<double>(current.gain) * current.integrationTime);
+
+        // Saturated counts only bound the rate from below, assume it is much higher
+        if (counts >= SATURATION)
+            rate *= SATURATED_RATE_FACTOR;
+
+        bool inWindow = counts >= low && counts <= high;
+        Setting best = choose(rate);
+        if (best == current || (inWindow && best.integrationTime >= current.integrationTime))
+            return false;
+
+        next = best;
+        return true;
+    }
+
+private:
+    static constexpr int GAINS[] = { 1, 25, 428, 9876 };
+    static constexpr int INTEGRATION_TIMES[] = { 100, 200, 300, 400, 500, 600 };
+    static constexpr int GAIN_STEPS = sizeof(GAINS) / sizeof(GAINS[0]);
+    static constexpr int INTEGRATION_STEPS = sizeof(INTEGRATION_TIMES) / sizeof(INTEGRATION_TIMES[0]);
+
+    static constexpr double SATURATION = 65000;
+    static constexpr double SATURATED_RATE_FACTOR = 10;
+    static constexpr double MARGIN = 1.25;  // a new setting aims this far inside the window
+
+    Setting choose(double rate) const
+    {
+        double targetLow = low * MARGIN;
+        double targetHigh = high / MARGIN;
+
+        for (int t = 0; t < INTEGRATION_STEPS; t++)
+        {
+            for (int g = GAIN_STEPS - 1; g >= 0; g--)
+            {
+                double predicted = rate * GAINS[g] * INTEGRATION_TIMES[t];
+                if (predicted > targetHigh)
+                    continue;
+
+                if (predicted >= targetLow)
+                    return Setting{GAINS[g], INTEGRATION_TIMES[t]};
+
+                // Lower gains only give fewer counts, try a longer integration
+                break;
+            }
+        }
+
+        // Too bright for the least sensitive setting, or too dark for the most
+        if (rate * GAINS[0] * INTEGRATION_TIMES[0] > targetHigh)
+            return Setting{GAINS[0], INTEGRATION_TIMES[0]};
+        return Setting{GAINS[GAIN_STEPS - 1], INTEGRATION_TIMES[INTEGRATION_STEPS - 1]};
+    }
+
+    double low = 2000;
+    double high = 40000;
+};
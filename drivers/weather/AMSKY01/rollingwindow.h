@@ -0,0 +1,200 @@
+/*
+    Rolling time window aggregate
+
+    Author: Roman Dvořák <info@astrometers.cz>
+    Copyright (C) 2025 Astrometers
+*/
+
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+#include <functional>
+
+// Mean, minimum and maximum of the values seen during the last span seconds,
+// each update and query is O(1). The span is cut into Slots time slots: every
+// slot keeps its own sum and count, and the running totals add a slot's values
+// as they come and subtract them when the slot falls out of the window.
+// Minimum and maximum come from monotonic deques holding at most one entry per
+// slot. Values expire with slot resolution, span / Slots.
+template <int Slots>
+class RollingWindow
+{
+public:
+    void reset(double spanSeconds)
+    {
+        width = spanSeconds / Slots;
+        for (auto &bucket : buckets)
+            bucket = Bucket();
+        sum = 0;
+        samples = 0;
+        started = false;
+        minimum.clear();
+        maximum.clear();
+    }
+
+    // time in seconds on a monotonic clock
+    void add(double time, double value)
+    {
+        int64_t slot = slotOf(time);
+        advance(slot);
+
+        Bucket &bucket = buckets[slot % Slots];
+        bucket.sum += value;
+        bucket.count++;
+        sum += value;
+        samples++;
+
+        minimum.push(slot, value);
+        maximum.push(slot, value);
+    }
+
+    // Drops whatever is older than span at time, for windows that went quiet
+    void expire(double time)
+    {
+        advance(slotOf(time));
+    }
+
+    uint32_t count() const
+    {
+        return samples;
+    }
+
+    double mean() const
+    {
+        return samples > 0 ? sum / samples : 0;
+    }
+
+    double min() const
+    {
+        return minimum.empty() ? 0 : minimum.front();
+    }
+
+    double max() const
+    {
+        return maximum.empty() ? 0 : maximum.front();
+    }
+
+private:
+    struct Bucket
+    {
+        double sum = 0;
+        uint32_t count = 0;
+    };
+
+    // Candidates for the extreme, oldest first; Better(a, b) when a beats b.
+    // A value is dropped as soon as a newer one at least as good arrives, it can
+    // never be the extreme again.
+    template <typename Better>
+    class MonotonicDeque
+    {
+    public:
+        void push(int64_t slot, double value)
+        {
+            while (size > 0 && !Better()(at(size - 1).value, value))
+                size--;
+
+            // An older entry of the same slot that still beats value also outlives it
+            if (size > 0 && at(size - 1).slot == slot)
+                return;
+
+            at(size++) = Entry{slot, value};
+        }
+
+        void expire(int64_t oldestSlot)
+        {
+            while (size > 0 && at(0).slot < oldestSlot)
+            {
+                head = (head + 1) % CAPACITY;
+                size--;
+            }
+        }
+
+        void clear()
+        {
+            head = 0;
+            size = 0;
+        }
+
+        bool empty() const
+        {
+            return size == 0;
+        }
+
+        double front() const
+        {
+            return entries[head].value;
+        }
+
+    private:
+        static constexpr int CAPACITY = Slots + 1;
+
+        struct Entry
+        {
+            int64_t slot;
+            double value;
+        };
+
+        Entry &at(int index)
+        {
+            return entries[(head + index) % CAPACITY];
+        }
+
+        Entry entries[CAPACITY] {};
+        int head = 0;
+        int size = 0;
+    };
+
+    int64_t slotOf(double time) const
+    {
+        return static_cast<int64_t>(std::floor(time / width));
+    }
+
+    void advance(int64_t slot)
+    {
+        if (!started)
+        {
+            current = slot;
+            started = true;
+        }
+
+        if (slot <= current)
+            return;
+
+        // Slots between the last update and now fall out of the window
+        if (slot - current >= Slots)
+        {
+            for (auto &bucket : buckets)
+                bucket = Bucket();
+            sum = 0;
+            samples = 0;
+        }
+        else
+        {
+            for (int64_t s = current + 1; s <= slot; s++)
+            {
+                Bucket &bucket = buckets[s % Slots];
+                sum -= bucket.sum;
+                samples -= bucket.count;
+                bucket = Bucket();
+            }
+        }
+
+        // Rounding left in the running sum does not outlive an empty window
+        if (samples == 0)
+            sum = 0;
+
+        current = slot;
+        minimum.expire(slot - Slots + 1);
+        maximum.expire(slot - Slots + 1);
+    }
+
+    double width = 1;
+    Bucket buckets[Slots];
+    double sum = 0;
+    uint32_t samples = 0;
+    int64_t current = 0;
+    bool started = false;
+    MonotonicDeque<std::less<double>> minimum;
+    MonotonicDeque<std::greater<double>> maximum;
+};
@@ -0,0 +1,578 @@
+/*
+    Append-only time-series store for AMSKY01 readings
+
+    Author: Roman Dvořák <info@astrometers.cz>
+    Copyright (C) 2025 Astrometers
+*/
+
+#include "timeseriesstore.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static const char SEGMENT_MAGIC[4] = { 'A', 'M', 'T', 'S' };
+static constexpr uint32_t SEGMENT_VERSION = 1;
+
+// How long the writer sleeps when there is nothing to append
+static constexpr std::chrono::milliseconds IDLE_SLEEP(200);
+
+// Bits are packed MSB first
+static void putBits(uint8_t *data, uint32_t &bitPos, uint64_t value, int bits)
+{
+    for (int i = bits - 1; i >= 0; i--)
+    {
+        if ((value >> i) & 1)
+            data[bitPos >> 3] |= 0x80 >> (bitPos & 7);
+        bitPos++;
+    }
+}
+
+static uint64_t getBits(const uint8_t *data, uint32_t &bitPos, int bits)
+{
+    uint64_t value = 0;
+    for (int i = 0; i < bits; i++)
+    {
+        value = (value << 1) | ((data[bitPos >> 3] >> (7 - (bitPos & 7))) & 1);
+        bitPos++;
+    }
+    return value;
+}
+
+static uint64_t doubleBits(double value)
+{
+    uint64_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    return bits;
+}
+
+static double bitsDouble(uint64_t bits)
+{
+    double value;
+    memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+TimeSeriesStore::TimeSeriesStore()
+{
+}
+
+TimeSeriesStore::~TimeSeriesStore()
+{
+    close();
+}
+
+bool TimeSeriesStore::open(const std::string &path, int channelCount)
+{
+    if (running)
+        return true;
+
+    directory = path;
+    channels = std::max(1, std::min(channelCount, MAX_CHANNELS));
+
+    std::error_code error;
+    std::filesystem::create_directories(directory, error);
+    if (error)
+        return false;
+
+    // Existing segments, oldest first
+    std::vector<uint32_t> segments;
+    for (const auto &entry : std::filesystem::directory_iterator(directory, error))
+    {
+        unsigned int number;
+        if (sscanf(entry.path().filename().c_str(), "segment-%8u.amts", &number) == 1)
+            segments.push_back(number);
+    }
+    std::sort(segments.begin(), segments.end());
+
+    std::lock_guard<std::mutex> lock(mutex);
+
+    index.clear();
+    recordCount = 0;
+    payloadBits = 0;
+    segmentCount = 0;
+
+    int usedBlocks = -1;
+    for (uint32_t segment : segments)
+    {
+        usedBlocks = scanSegment(segment);
+        if (usedBlocks >= 0)
+            segmentCount++;
+    }
+
+    // Keep filling the newest segment if it still has room and matches our layout
+    bool ok;
+    if (!segments.empty() && usedBlocks >= 0 && static_cast<uint32_t>(usedBlocks) + 1 < BLOCKS_PER_SEGMENT)
+    {
+        activeSegment = segments.back();
+        nextBlock = usedBlocks + 1;
+        ok = openSegment(activeSegment, false);
+    }
+    else
+    {
+        activeSegment = segments.empty() ? 0 : segments.back() + 1;
+        nextBlock = 1;
+        ok = openSegment(activeSegment, true);
+    }
+
+    if (!ok)
+        return false;
+
+    // The first record always opens a fresh block
+    encoder = Encoder();
+    queue.clear();
+    dropped = 0;
+
+    running = true;
+    writer = std::thread(&TimeSeriesStore::writerLoop, this);
+    return true;
+}
+
+void TimeSeriesStore::close()
+{
+    running = false;
+    if (writer.joinable())
+        writer.join();
+
+    std::lock_guard<std::mutex> lock(mutex);
+    closeSegment();
+    index.clear();
+}
+
+bool TimeSeriesStore::append(int64_t timestamp, const double *values)
+{
+    if (!running)
+        return false;
+
+    Record *record = queue.claim();
+    if (record == nullptr)
+    {
+        dropped.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+
+    record->timestamp = timestamp;
+    memcpy(record->values, values, channels * sizeof(double));
+    queue.publish();
+    return true;
+}
+
+TimeSeriesStore::Stats TimeSeriesStore::stats() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    Stats stats;
+    stats.records = recordCount;
+    stats.blocks = index.size();
+    stats.segments = segmentCount;
+    stats.bytes = payloadBits / 8;
+    stats.dropped = dropped.load(std::memory_order_relaxed);
+    return stats;
+}
+
+void TimeSeriesStore::writerLoop()
+{
+    while (running)
+    {
+        bool wrote = false;
+        while (Record *record = queue.front())
+        {
+            writeRecord(*record);
+            queue.release();
+            wrote = true;
+        }
+
+        if (!wrote)
+            std::this_thread::sleep_for(IDLE_SLEEP);
+    }
+
+    // Records queued before close() still get written
+    while (Record *record = queue.front())
+    {
+        writeRecord(*record);
+        queue.release();
+    }
+}
+
+void TimeSeriesStore::writeRecord(const Record &record)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    if (segmentMap == nullptr)
+        return;
+
+    // Keep the index sorted even if the wall clock steps back
+    int64_t timestamp = record.timestamp;
+    if (encoder.header != nullptr && timestamp < encoder.prevTimestamp)
+        timestamp = encoder.prevTimestamp;
+
+    int64_t delta = timestamp - encoder.prevTimestamp;
+    uint32_t worstCase = 4 + 32 + channels * (2 + 5 + 6 + 64);
+    uint32_t startBits = encoder.bitPos;
+
+    if (encoder.header == nullptr || delta > INT32_MAX || encoder.bitPos + worstCase > BLOCK_BITS)
+    {
+        if (!startBlock(timestamp))
+            return;
+        startBits = 0;
+
+        // First record of a block is stored raw
+        putBits(encoder.data, encoder.bitPos, static_cast<uint64_t>(timestamp), 64);
+        for (int i = 0; i < channels; i++)
+        {
+            encoder.prevValue[i] = doubleBits(record.values[i]);
+            encoder.prevLeading[i] = -1;
+            putBits(encoder.data, encoder.bitPos, encoder.prevValue[i], 64);
+        }
+    }
+    else
+    {
+        // Timestamp: delta of delta, most samples arrive at a steady rate and cost one bit
+        int64_t dod = delta - encoder.prevDelta;
+        if (dod == 0)
+            putBits(encoder.data, encoder.bitPos, 0, 1);
+        else if (dod >= -63 && dod <= 64)
+        {
+            putBits(encoder.data, encoder.bitPos, 0x2, 2);
+            putBits(encoder.data, encoder.bitPos, dod + 63, 7);
+        }
+        else if (dod >= -255 && dod <= 256)
+        {
+            putBits(encoder.data, encoder.bitPos, 0x6, 3);
+            putBits(encoder.data, encoder.bitPos, dod + 255, 9);
+        }
+        else if (dod >= -2047 && dod <= 2048)
+        {
+            putBits(encoder.data, encoder.bitPos, 0xE, 4);
+            putBits(encoder.data, encoder.bitPos, dod + 2047, 12);
+        }
+        else
+        {
+            putBits(encoder.data, encoder.bitPos, 0xF, 4);
+            putBits(encoder.data, encoder.bitPos, static_cast<uint32_t>(static_cast<int32_t>(dod)), 32);
+        }
+        encoder.prevDelta = delta;
+
+        // Values: XOR with the previous one, slow channels mostly cost a bit or a few
+        for (int i = 0; i < channels; i++)
+        {
+            uint64_t bits = doubleBits(record.values[i]);
+            uint64_t xorValue = bits ^ encoder.prevValue[i];
+            encoder.prevValue[i] = bits;
+
+            if (xorValue == 0)
+            {
+                putBits(encoder.data, encoder.bitPos, 0, 1);
+                continue;
+            }
+
+            int leading = std::min(__builtin_clzll(xorValue), 31);
+            int trailing = __builtin_ctzll(xorValue);
+
+            if (encoder.prevLeading[i] >= 0 && leading >= encoder.prevLeading[i] && trailing >= encoder.prevTrailing[i])
+            {
+                // Fits the previous meaningful bit window
+                int length = 64 - encoder.prevLeading[i] - encoder.prevTrailing[i];
+                putBits(encoder.data, encoder.bitPos, 0x2, 2);
+                putBits(encoder.data, encoder.bitPos, xorValue >> encoder.prevTrailing[i], length);
+            }
+            else
+            {
+                int length = 64 - leading - trailing;
+                putBits(encoder.data, encoder.bitPos, 0x3, 2);
+                putBits(encoder.data, encoder.bitPos, leading, 5);
+                putBits(encoder.data, encoder.bitPos, length & 63, 6);
+                putBits(encoder.data, encoder.bitPos, xorValue >> trailing, length);
+                encoder.prevLeading[i] = leading;
+                encoder.prevTrailing[i] = trailing;
+            }
+        }
+    }
+
+    encoder.prevTimestamp = timestamp;
+
+    // Count goes last, a record becomes visible only once all of it is in place
+    encoder.header->lastTimestamp = timestamp;
+    encoder.header->bitLength = encoder.bitPos;
+    __atomic_store_n(&encoder.header->count, encoder.header->count + 1, __ATOMIC_RELEASE);
+
+    index.back().lastTimestamp = timestamp;
+    recordCount++;
+    payloadBits += encoder.bitPos - startBits;
+}
+
+bool TimeSeriesStore::startBlock(int64_t timestamp)
+{
+    // Roll over to a new segment file once this one is full
+    if (nextBlock >= BLOCKS_PER_SEGMENT)
+    {
+        closeSegment();
+        activeSegment++;
+        nextBlock = 1;
+        if (!openSegment(activeSegment, true))
+            return false;
+    }
+
+    uint8_t *block = segmentMap + static_cast<size_t>(nextBlock) * BLOCK_SIZE;
+    memset(block, 0, BLOCK_SIZE);
+
+    encoder = Encoder();
+    encoder.header = reinterpret_cast<BlockHeader *>(block);
+    encoder.data = block + BLOCK_HEADER_SIZE;
+    encoder.prevTimestamp = timestamp;
+    encoder.header->firstTimestamp = timestamp;
+    encoder.header->lastTimestamp = timestamp;
+
+    index.push_back({ timestamp, timestamp, activeSegment, nextBlock });
+    nextBlock++;
+    return true;
+}
+
+bool TimeSeriesStore::openSegment(uint32_t segment, bool create)
+{
+    const size_t size = static_cast<size_t>(BLOCK_SIZE) * BLOCKS_PER_SEGMENT;
+    std::string path = segmentPath(segment);
+
+    segmentFD = ::open(path.c_str(), O_RDWR | O_CLOEXEC | (create ? O_CREAT | O_TRUNC : 0), 0644);
+    if (segmentFD < 0)
+        return false;
+
+    // Reserve the whole segment up front so appends never extend the file
+    if (create && posix_fallocate(segmentFD, 0, size) != 0 && ftruncate(segmentFD, size) != 0)
+    {
+        closeSegment();
+        return false;
+    }
+
+    void *map = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, segmentFD, 0);
+    if (map == MAP_FAILED)
+    {
+        closeSegment();
+        return false;
+    }
+    segmentMap = static_cast<uint8_t *>(map);
+
+    if (create)
+    {
+        SegmentHeader *header = reinterpret_cast<SegmentHeader *>(segmentMap);
+        memcpy(header->magic, SEGMENT_MAGIC, sizeof(SEGMENT_MAGIC));
+        header->version = SEGMENT_VERSION;
+        header->channels = channels;
+        header->blockSize = BLOCK_SIZE;
+        header->blocks = BLOCKS_PER_SEGMENT;
+        segmentCount++;
+    }
+
+    return true;
+}
+
+void TimeSeriesStore::closeSegment()
+{
+    const size_t size = static_cast<size_t>(BLOCK_SIZE) * BLOCKS_PER_SEGMENT;
+
+    if (segmentMap != nullptr)
+    {
+        msync(segmentMap, size, MS_SYNC);
+        munmap(segmentMap, size);
+        segmentMap = nullptr;
+    }
+
+    if (segmentFD >= 0)
+    {
+        ::close(segmentFD);
+        segmentFD = -1;
+    }
+
+    encoder = Encoder();
+}
+
+int TimeSeriesStore::scanSegment(uint32_t segment)
+{
+    const size_t size = static_cast<size_t>(BLOCK_SIZE) * BLOCKS_PER_SEGMENT;
+
+    int fd = ::open(segmentPath(segment).c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+        return -1;
+
+    struct stat st;
+    void *map = MAP_FAILED;
+    if (fstat(fd, &st) == 0 && static_cast<size_t>(st.st_size) == size)
+        map = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+
+    if (map == MAP_FAILED)
+        return -1;
+
+    const uint8_t *data = static_cast<const uint8_t *>(map);
+    const SegmentHeader *header = reinterpret_cast<const SegmentHeader *>(data);
+
+    int used = -1;
+    if (memcmp(header->magic, SEGMENT_MAGIC, sizeof(SEGMENT_MAGIC)) == 0 && header->version == SEGMENT_VERSION &&
+            header->channels == static_cast<uint32_t>(channels) && header->blockSize == BLOCK_SIZE &&
+            header->blocks == BLOCKS_PER_SEGMENT)
+    {
+        // Blocks are filled in order, the first empty one ends the segment
+        used = 0;
+        for (uint32_t block = 1; block < BLOCKS_PER_SEGMENT; block++)
+        {
+            const BlockHeader *blockHeader = reinterpret_cast<const BlockHeader *>(data + static_cast<size_t>(block) * BLOCK_SIZE);
+            if (blockHeader->count == 0)
+                break;
+
+            index.push_back({ blockHeader->firstTimestamp, blockHeader->lastTimestamp, segment, block });
+            recordCount += blockHeader->count;
+            payloadBits += blockHeader->bitLength;
+            used = block;
+        }
+    }
+
+    munmap(map, size);
+    return used;
+}
+
+std::string TimeSeriesStore::segmentPath(uint32_t segment) const
+{
+    char name[32];
+    snprintf(name, sizeof(name), "segment-%08u.amts", segment);
+    return directory + "/" + name;
+}
+
+size_t TimeSeriesStore::query(int64_t from, int64_t to, const std::function<void(int64_t, const double *)> &visitor)
+{
+    const size_t size = static_cast<size_t>(BLOCK_SIZE) * BLOCKS_PER_SEGMENT;
+
+    std::lock_guard<std::mutex> lock(mutex);
+
+    // Last block starting at or before from, everything earlier ends before the range
+    auto entry = std::upper_bound(index.begin(), index.end(), from,
+                                  [](int64_t timestamp, const IndexEntry &e) { return timestamp < e.firstTimestamp; });
+    if (entry != index.begin())
+        --entry;
+
+    size_t visited = 0;
+    uint32_t mappedSegment = 0;
+    const uint8_t *mapped = nullptr;
+
+    for (; entry != index.end() && entry->firstTimestamp <= to; ++entry)
+    {
+        if (entry->lastTimestamp < from)
+            continue;
+
+        const uint8_t *segmentData;
+        if (entry->segment == activeSegment && segmentMap != nullptr)
+            segmentData = segmentMap;
+        else
+        {
+            // Older segments are mapped read-only for the duration of the scan
+            if (mapped == nullptr || mappedSegment != entry->segment)
+            {
+                if (mapped != nullptr)
+                    munmap(const_cast<uint8_t *>(mapped), size);
+                mapped = nullptr;
+
+                int fd = ::open(segmentPath(entry->segment).c_str(), O_RDONLY | O_CLOEXEC);
+                if (fd < 0)
+                    continue;
+                void *map = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+                ::close(fd);
+                if (map == MAP_FAILED)
+                    continue;
+
+                madvise(map, size, MADV_SEQUENTIAL);
+                mapped = static_cast<const uint8_t *>(map);
+                mappedSegment = entry->segment;
+            }
+            segmentData = mapped;
+        }
+
+        visited += decodeBlock(segmentData + static_cast<size_t>(entry->block) * BLOCK_SIZE, from, to, visitor);
+    }
+
+    if (mapped != nullptr)
+        munmap(const_cast<uint8_t *>(mapped), size);
+
+    return visited;
+}
+
+size_t TimeSeriesStore::decodeBlock(const uint8_t *block, int64_t from, int64_t to,
+                                    const std::function<void(int64_t, const double *)> &visitor) const
+{
+    const BlockHeader *header = reinterpret_cast<const BlockHeader *>(block);
+    const uint8_t *data = block + BLOCK_HEADER_SIZE;
+    uint32_t count = __atomic_load_n(&header->count, __ATOMIC_ACQUIRE);
+
+    uint32_t bitPos = 0;
+    int64_t timestamp = 0;
+    int64_t delta = 0;
+    uint64_t value[MAX_CHANNELS] {};
+    int leading[MAX_CHANNELS] {};
+    int trailing[MAX_CHANNELS] {};
+    double values[MAX_CHANNELS];
+    size_t visited = 0;
+
+    for (uint32_t n = 0; n < count; n++)
+    {
+        if (n == 0)
+        {
+            timestamp = static_cast<int64_t>(getBits(data, bitPos, 64));
+            for (int i = 0; i < channels; i++)
+                value[i] = getBits(data, bitPos, 64);
+        }
+        else
+        {
+            int64_t dod;
+            if (getBits(data, bitPos, 1) == 0)
+                dod = 0;
+            else if (getBits(data, bitPos, 1) == 0)
+                dod = static_cast<int64_t>(getBits(data, bitPos, 7)) - 63;
+            else if (getBits(data, bitPos, 1) == 0)
+                dod = static_cast<int64_t>(getBits(data, bitPos, 9)) - 255;
+            else if (getBits(data, bitPos, 1) == 0)
+                dod = static_cast<int64_t>(getBits(data, bitPos, 12)) - 2047;
+            else
+                dod = static_cast<int32_t>(getBits(data, bitPos, 32));
+
+            delta += dod;
+            timestamp += delta;
+
+            for (int i = 0; i < channels; i++)
+            {
+                if (getBits(data, bitPos, 1) == 0)
+                    continue;
+
+                if (getBits(data, bitPos, 1) == 0)
+                {
+                    int length = 64 - leading[i] - trailing[i];
+                    value[i] ^= getBits(data, bitPos, length) << trailing[i];
+                }
+                else
+                {
+                    leading[i] = static_cast<int>(getBits(data, bitPos, 5));
+                    int length = static_cast<int>(getBits(data, bitPos, 6));
+                    if (length == 0)
+                        length = 64;
+                    trailing[i] = 64 - leading[i] - length;
+                    value[i] ^= getBits(data, bitPos, length) << trailing[i];
+                }
+            }
+        }
+
+        if (timestamp > to)
+            break;
+        if (timestamp < from)
+            continue;
+
+        for (int i = 0; i < channels; i++)
+            values[i] = bitsDouble(value[i]);
+        visitor(timestamp, values);
+        visited++;
+    }
+
+    return visited;
+}
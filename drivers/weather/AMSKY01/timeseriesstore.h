@@ -0,0 +1,141 @@
+/*
+    Append-only time-series store for AMSKY01 readings
+
+    Records are compressed Gorilla style (delta-of-delta timestamps, XOR
+    encoded values) into fixed-size blocks of memory-mapped segment files.
+    A sparse in-memory index of block start times turns a time range query
+    into a binary search plus a sequential scan.
+
+    Author: Roman Dvořák <info@astrometers.cz>
+    Copyright (C) 2025 Astrometers
+*/
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "spscqueue.h"
+
+class TimeSeriesStore
+{
+public:
+    static constexpr int MAX_CHANNELS = 16;
+
+    struct Stats
+    {
+        uint64_t records;
+        uint64_t blocks;
+        uint32_t segments;
+        uint64_t bytes;       // compressed payload
+        uint64_t dropped;     // records the writer could not take in time
+    };
+
+    TimeSeriesStore();
+    ~TimeSeriesStore();
+
+    // Opens or creates the store in directory and starts the writer thread
+    bool open(const std::string &directory, int channels);
+    void close();
+    bool isOpen() const
+    {
+        return running;
+    }
+
+    // Ingest path: a single queue push, timestamp in ms since the epoch.
+    // Returns false when the writer is behind and the record was dropped.
+    bool append(int64_t timestamp, const double *values);
+
+    // Calls visitor for each record with from <= timestamp <= to, oldest first.
+    // Returns the number of records visited.
+    size_t query(int64_t from, int64_t to, const std::function<void(int64_t, const double *)> &visitor);
+
+    Stats stats() const;
+
+private:
+    static constexpr uint32_t BLOCK_SIZE = 4096;
+    static constexpr uint32_t BLOCKS_PER_SEGMENT = 1024;   // 4 MB segments, block 0 is the file header
+    static constexpr uint32_t BLOCK_HEADER_SIZE = 24;
+    static constexpr uint32_t BLOCK_BITS = (BLOCK_SIZE - BLOCK_HEADER_SIZE) * 8;
+
+    struct Record
+    {
+        int64_t timestamp;
+        double values[MAX_CHANNELS];
+    };
+
+    // On-disk layout, both little endian as written by the host
+    struct SegmentHeader
+    {
+        char magic[4];
+        uint32_t version;
+        uint32_t channels;
+        uint32_t blockSize;
+        uint32_t blocks;
+    };
+
+    struct BlockHeader
+    {
+        int64_t firstTimestamp;
+        int64_t lastTimestamp;
+        uint32_t count;         // written last, so a torn append is never visible
+        uint32_t bitLength;
+    };
+
+    // Sparse index: one entry per block
+    struct IndexEntry
+    {
+        int64_t firstTimestamp;
+        int64_t lastTimestamp;
+        uint32_t segment;
+        uint32_t block;
+    };
+
+    // Gorilla encoder state of the block being filled
+    struct Encoder
+    {
+        uint8_t *data = nullptr;
+        BlockHeader *header = nullptr;
+        uint32_t bitPos = 0;
+        int64_t prevTimestamp = 0;
+        int64_t prevDelta = 0;
+        uint64_t prevValue[MAX_CHANNELS] {};
+        int prevLeading[MAX_CHANNELS] {};
+        int prevTrailing[MAX_CHANNELS] {};
+    };
+
+    void writerLoop();
+    void writeRecord(const Record &record);
+    bool startBlock(int64_t timestamp);
+    bool openSegment(uint32_t segment, bool create);
+    void closeSegment();
+    int scanSegment(uint32_t segment);
+    std::string segmentPath(uint32_t segment) const;
+    size_t decodeBlock(const uint8_t *block, int64_t from, int64_t to,
+                       const std::function<void(int64_t, const double *)> &visitor) const;
+
+    std::string directory;
+    int channels = 0;
+
+    SPSCQueue<Record, 1024> queue;
+    std::thread writer;
+    std::atomic<bool> running{false};
+    std::atomic<uint64_t> dropped{0};
+
+    // Guards everything below, shared by the writer and queries
+    mutable std::mutex mutex;
+    std::vector<IndexEntry> index;
+    uint32_t activeSegment = 0;
+    uint32_t nextBlock = 0;
+    int segmentFD = -1;
+    uint8_t *segmentMap = nullptr;
+    Encoder encoder;
+    uint64_t recordCount = 0;
+    uint64_t payloadBits = 0;
+    uint32_t segmentCount = 0;
+};